@@ -0,0 +1,414 @@
+/**********************************************************************************************************************************************\
+	Copyright© 2021 Mason DeRoss
+
+	Released under either the GNU All-permissive License or MIT license. You pick.
+
+	Copying and distribution of this file, with or without modification, are permitted in any medium without royalty,
+	provided the copyright notice and this notice are preserved. This file is offered as-is, without any warranty.
+
+	DESCRIPTION:
+		File streams that overlap disk I/O with inflate/deflate: read-ahead for png::reader, write-behind for png::writer.
+
+\**********************************************************************************************************************************************/
+#ifndef PNGPP_ASYNC_FILE_HPP_INCLUDED
+#define PNGPP_ASYNC_FILE_HPP_INCLUDED
+
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "types.hpp"
+#include "error.hpp"
+#include "buffered_io.hpp"
+
+namespace png
+{
+
+namespace detail
+{
+
+/**
+ * \brief A bounded queue of I/O blocks shared between the decoding/encoding thread and the I/O thread. Emptied blocks are recycled.
+ */
+class block_queue
+{
+public:
+	using block = ::std::vector<byte>;
+
+	inline block_queue(size_t block_size, size_t depth) : m_block_size(block_size), m_depth(::std::max<size_t>(depth, 1)) {}
+
+	/**
+	 * \brief Returns a recycled (or new) empty block with block_size bytes of capacity.
+	 */
+	inline block acquire()
+	{
+		::std::lock_guard lock(m_mutex);
+		if (m_free.empty())
+		{
+			block b;
+			b.reserve(m_block_size);
+			return b;
+		}
+		block b{::std::move(m_free.back())};
+		m_free.pop_back();
+		b.clear();
+		return b;
+	}
+
+	inline void recycle(block&& b)
+	{
+		::std::lock_guard lock(m_mutex);
+		m_free.push_back(::std::move(b));
+	}
+
+	/**
+	 * \brief Queues \a b, waiting while \c depth blocks are already in flight. Returns false if the queue was closed.
+	 */
+	inline bool push(block&& b)
+	{
+		::std::unique_lock lock(m_mutex);
+		m_space.wait(lock, [this]{ return m_closed || m_blocks.size() < m_depth; });
+		if (m_closed)
+		{
+			return false;
+		}
+		m_blocks.push_back(::std::move(b));
+		m_ready.notify_one();
+		return true;
+	}
+
+	/**
+	 * \brief Takes the oldest block, waiting for one to arrive. Returns false once the queue is closed and drained.
+	 */
+	inline bool pop(block& b)
+	{
+		::std::unique_lock lock(m_mutex);
+		m_ready.wait(lock, [this]{ return m_closed || !m_blocks.empty(); });
+		if (m_blocks.empty())
+		{
+			return false;
+		}
+		b = ::std::move(m_blocks.front());
+		m_blocks.pop_front();
+		++m_busy;
+		m_space.notify_one();
+		return true;
+	}
+
+	/**
+	 * \brief Marks the block last taken by pop() as fully processed.
+	 */
+	inline void done()
+	{
+		::std::lock_guard lock(m_mutex);
+		--m_busy;
+		m_idle.notify_all();
+	}
+
+	/**
+	 * \brief Waits until every queued block has been popped and processed.
+	 */
+	inline void wait_idle()
+	{
+		::std::unique_lock lock(m_mutex);
+		m_idle.wait(lock, [this]{ return m_blocks.empty() && m_busy == 0; });
+	}
+
+	inline void close()
+	{
+		::std::lock_guard lock(m_mutex);
+		m_closed = true;
+		m_ready.notify_all();
+		m_space.notify_all();
+		m_idle.notify_all();
+	}
+
+	inline size_t get_block_size() const noexcept
+	{
+		return m_block_size;
+	}
+
+private:
+	size_t m_block_size;
+	size_t m_depth;
+	size_t m_busy{0};
+	bool m_closed{false};
+	::std::deque<block> m_blocks;
+	::std::vector<block> m_free;
+	::std::mutex m_mutex;
+	::std::condition_variable m_ready;
+	::std::condition_variable m_space;
+	::std::condition_variable m_idle;
+};
+
+struct file_closer
+{
+	inline void operator()(::std::FILE* file) const noexcept
+	{
+		::std::fclose(file);
+	}
+};
+
+/**
+ * \brief A FILE that is closed however its owner is left, a constructor throwing half way included.
+ */
+using file_ptr = ::std::unique_ptr<::std::FILE, file_closer>;
+
+inline file_ptr open_unbuffered(const char* filename, const char* mode)
+{
+	file_ptr file{::std::fopen(filename, mode)};
+	if (!file)
+	{
+		throw std_error(filename);
+	}
+	::std::setvbuf(file.get(), nullptr, _IONBF, 0);
+	return file;
+}
+
+} // namespace detail
+
+/**
+ * \brief Reads a file on a background thread, keeping up to \c queue_depth blocks in flight ahead of the decoder.
+ *
+ * Implements the \c istream interface expected by the reader class. While libpng inflates one block the I/O thread is already waiting on
+ * storage for the next ones, so the decoding thread only blocks when the disk really cannot keep up.
+ *
+ * Reading past the end of the file clears good(); a read error throws std_error instead, once the data read before it is used up.
+ *
+ * \see async_file_ostream, reader
+ */
+class async_file_istream
+{
+private:
+	async_file_istream() = delete;
+
+	async_file_istream(const async_file_istream&) = delete;
+	async_file_istream(async_file_istream&&) = delete;
+
+	async_file_istream& operator=(const async_file_istream&) = delete;
+	async_file_istream& operator=(async_file_istream&&) = delete;
+
+public:
+	explicit inline async_file_istream(const char* filename, size_t block_size = default_io_block_size, size_t queue_depth = 4)
+		: m_file(detail::open_unbuffered(filename, "rb")), m_queue(::std::max<size_t>(block_size, 1), queue_depth)
+	{
+		m_thread = ::std::thread([this]{ read_ahead(); });
+	}
+
+	explicit inline async_file_istream(const ::std::string& filename, size_t block_size = default_io_block_size, size_t queue_depth = 4)
+		: async_file_istream(filename.c_str(), block_size, queue_depth) {}
+
+	inline ~async_file_istream() noexcept
+	{
+		m_queue.close();
+		m_thread.join();
+	}
+
+	inline void read(char* data, size_t length)
+	{
+		while (length > 0)
+		{
+			if (m_pos == m_block.size())
+			{
+				m_queue.recycle(::std::move(m_block));
+				m_pos = 0;
+				if (!m_queue.pop(m_block))
+				{
+					m_block.clear();
+					end_of_data();
+					return;
+				}
+				m_queue.done();
+				if (m_block.empty())
+				{
+					end_of_data();
+					return;
+				}
+			}
+
+			size_t count{::std::min(length, m_block.size() - m_pos)};
+			::std::memcpy(data, m_block.data() + m_pos, count);
+			m_pos += count;
+			data += count;
+			length -= count;
+		}
+	}
+
+	inline constexpr bool good() const noexcept
+	{
+		return m_good;
+	}
+
+private:
+	/**
+	 * \brief The blocks ran out: the end of the file, or the read error the I/O thread stopped at.
+	 */
+	inline void end_of_data()
+	{
+		m_good = false;
+		// written before the I/O thread queued its last block or closed the queue, so the queue's mutex orders it before this read
+		if (m_errno != 0)
+		{
+			throw std_error("async_file_istream: read failed", m_errno);
+		}
+	}
+
+	inline void read_ahead() noexcept
+	{
+		try
+		{
+			for (;;)
+			{
+				auto b{m_queue.acquire()};
+				b.resize(m_queue.get_block_size());
+				b.resize(::std::fread(b.data(), 1, b.size(), m_file.get()));
+				bool last{b.size() < m_queue.get_block_size()};
+				if (last && ::std::ferror(m_file.get()))
+				{
+					m_errno = errno != 0 ? errno : EIO;
+				}
+				// a short block marks end of file or a read error; an empty one tells the reader there is nothing more
+				if (!m_queue.push(::std::move(b)) || last)
+				{
+					break;
+				}
+			}
+		}
+		catch (...)
+		{
+			m_errno = ENOMEM;
+		}
+		m_queue.close();
+	}
+
+	detail::file_ptr m_file;
+	detail::block_queue m_queue;
+	detail::block_queue::block m_block;
+	size_t m_pos{0};
+	bool m_good{true};
+	int m_errno{0};
+	::std::thread m_thread;
+};
+
+/**
+ * \brief Writes a file on a background thread, keeping up to \c queue_depth blocks in flight behind the encoder.
+ *
+ * Implements the \c ostream interface expected by the writer class. \c flush() waits for all queued blocks to reach the file; a write
+ * error is reported by good() on the next call after it happened.
+ *
+ * \see async_file_istream, writer
+ */
+class async_file_ostream
+{
+private:
+	async_file_ostream() = delete;
+
+	async_file_ostream(const async_file_ostream&) = delete;
+	async_file_ostream(async_file_ostream&&) = delete;
+
+	async_file_ostream& operator=(const async_file_ostream&) = delete;
+	async_file_ostream& operator=(async_file_ostream&&) = delete;
+
+public:
+	explicit inline async_file_ostream(const char* filename, size_t block_size = default_io_block_size, size_t queue_depth = 4)
+		: m_file(detail::open_unbuffered(filename, "wb")), m_queue(::std::max<size_t>(block_size, 1), queue_depth)
+	{
+		m_block = m_queue.acquire();
+		m_thread = ::std::thread([this]{ write_behind(); });
+	}
+
+	explicit inline async_file_ostream(const ::std::string& filename, size_t block_size = default_io_block_size, size_t queue_depth = 4)
+		: async_file_ostream(filename.c_str(), block_size, queue_depth) {}
+
+	inline ~async_file_ostream() noexcept
+	{
+		try
+		{
+			submit();
+			m_queue.wait_idle();
+		}
+		catch (...)
+		{
+		}
+		m_queue.close();
+		m_thread.join();
+	}
+
+	inline void write(const char* data, size_t length)
+	{
+		while (length > 0)
+		{
+			size_t count{::std::min(length, m_queue.get_block_size() - m_block.size())};
+			m_block.insert(m_block.end(), reinterpret_cast<const byte*>(data), reinterpret_cast<const byte*>(data) + count);
+			data += count;
+			length -= count;
+			if (m_block.size() == m_queue.get_block_size())
+			{
+				submit();
+			}
+		}
+	}
+
+	inline void flush()
+	{
+		submit();
+		m_queue.wait_idle();
+		if (::std::fflush(m_file.get()) != 0)
+		{
+			m_failed = true;
+		}
+	}
+
+	inline bool good() const noexcept
+	{
+		return !m_failed;
+	}
+
+private:
+	inline void submit()
+	{
+		if (!m_block.empty())
+		{
+			if (!m_queue.push(::std::move(m_block)))
+			{
+				m_failed = true;
+			}
+			m_block = m_queue.acquire();
+		}
+	}
+
+	inline void write_behind() noexcept
+	{
+		detail::block_queue::block b;
+		while (m_queue.pop(b))
+		{
+			if (::std::fwrite(b.data(), 1, b.size(), m_file.get()) != b.size())
+			{
+				m_failed = true;
+			}
+			m_queue.recycle(::std::move(b));
+			m_queue.done();
+		}
+	}
+
+	detail::file_ptr m_file;
+	detail::block_queue m_queue;
+	detail::block_queue::block m_block;
+	::std::atomic<bool> m_failed{false};
+	::std::thread m_thread;
+};
+
+} // namespace png
+
+#endif // PNGPP_ASYNC_FILE_HPP_INCLUDED
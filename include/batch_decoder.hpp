@@ -0,0 +1,198 @@
+/**********************************************************************************************************************************************\
+	Copyright© 2021 Mason DeRoss
+
+	Released under either the GNU All-permissive License or MIT license. You pick.
+
+	Copying and distribution of this file, with or without modification, are permitted in any medium without royalty,
+	provided the copyright notice and this notice are preserved. This file is offered as-is, without any warranty.
+
+	DESCRIPTION:
+		Decodes many PNG images in parallel, each worker thread reusing its own image and pixel buffers.
+
+\**********************************************************************************************************************************************/
+#ifndef PNGPP_BATCH_DECODER_HPP_INCLUDED
+#define PNGPP_BATCH_DECODER_HPP_INCLUDED
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <ranges>
+#include <span>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "types.hpp"
+#include "image.hpp"
+#include "worker_threads.hpp"
+
+namespace png
+{
+
+/**
+ * \brief Decodes a batch of PNG images on a fixed number of worker threads.
+ *
+ * Every worker owns one image object for the lifetime of the batch_decoder and decodes each of its items into it, so after the first few
+ * images the pixel rows, row vectors and palette are reused instead of being reallocated for every decode. Items are handed out one at a
+ * time from a shared counter, which keeps all workers busy when the images differ in size.
+ *
+ * The result of every item is delivered on the worker thread that decoded it:
+ *
+ * \code
+ * png::batch_decoder<png::rgb_pixel> decoder;
+ * decoder.decode(std::span(filenames), [](size_t index, png::image<png::rgb_pixel>& img, std::exception_ptr error)
+ * {
+ *		if (!error)
+ *		{
+ *			store_thumbnail(index, img);
+ *		}
+ * });
+ * \endcode
+ *
+ * The image passed to the callback is overwritten by the worker's next item; copy or swap it out if it must outlive the call. When \c
+ * error is set, the contents of the image are unspecified. The sources are any sized random access range, such as a \c std::vector or
+ * a \c std::span, of file names (\c std::string, \c const \c char*, \c std::filesystem::path) or in-memory PNG data (anything
+ * convertible to \c std::span<const \c byte>).
+ *
+ * \see image
+ */
+template<typename pixel, typename pixel_buffer_type = pixel_buffer<pixel>>
+class batch_decoder
+{
+private:
+	batch_decoder(const batch_decoder&) = delete;
+	batch_decoder(batch_decoder&&) = delete;
+
+	batch_decoder& operator=(const batch_decoder&) = delete;
+	batch_decoder& operator=(batch_decoder&&) = delete;
+
+public:
+	using image_type = image<pixel, pixel_buffer_type>;
+	using callback = ::std::function<void(size_t, image_type&, ::std::exception_ptr)>;
+
+	/**
+	 * \brief Constructs a decoder running \a thread_count workers; zero picks \c std::thread::hardware_concurrency().
+	 */
+	explicit inline batch_decoder(size_t thread_count = 0)
+		: m_workers(thread_count ? thread_count : ::std::max<size_t>(::std::thread::hardware_concurrency(), 1)) {}
+
+	inline ~batch_decoder() noexcept = default;
+
+	inline size_t get_thread_count() const noexcept
+	{
+		return m_workers.size();
+	}
+
+	/**
+	 * \brief Decodes every item of \a sources using the default converting transform and reports each one to \a on_done.
+	 *
+	 * Returns once all items have been reported. Exceptions thrown by \a on_done are caught and rethrown from here after the batch.
+	 */
+	template<::std::ranges::random_access_range range>
+	inline void decode(const range& sources, const callback& on_done)
+	{
+		decode(sources, on_done, typename image_type::transform_convert());
+	}
+
+	/**
+	 * \brief Decodes every item of \a sources using a custom transformation and reports each one to \a on_done.
+	 *
+	 * \a transform is shared by all workers and must be safe to call concurrently.
+	 */
+	template<::std::ranges::random_access_range range, typename transformation>
+	inline void decode(const range& sources, const callback& on_done, const transformation& transform)
+	{
+		const size_t size{static_cast<size_t>(::std::ranges::size(sources))};
+		::std::atomic<size_t> next{0};
+		::std::exception_ptr callback_error;
+		::std::atomic_flag callback_failed;
+
+		auto work = [&](image_type& img)
+		{
+			for (size_t i{next++}; i < size; i = next++)
+			{
+				::std::exception_ptr error;
+				try
+				{
+					read_source(img, ::std::ranges::begin(sources)[static_cast<::std::ptrdiff_t>(i)], transform);
+				}
+				catch (...)
+				{
+					error = ::std::current_exception();
+				}
+
+				try
+				{
+					on_done(i, img, error);
+				}
+				catch (...)
+				{
+					if (!callback_failed.test_and_set())
+					{
+						callback_error = ::std::current_exception();
+					}
+					next = size;
+				}
+			}
+		};
+
+		if (size > 0)
+		{
+			detail::run_workers(::std::min(m_workers.size(), size), [this, &work](size_t t){ work(m_workers[t]); });
+		}
+
+		if (callback_error)
+		{
+			::std::rethrow_exception(callback_error);
+		}
+	}
+
+private:
+	template<typename source, typename transformation>
+	static inline void read_source(image_type& img, const source& src, const transformation& transform)
+	{
+		if constexpr (::std::is_convertible_v<const source&, ::std::span<const byte>>)
+		{
+			read_input(img, ::std::span<const byte>(src), transform);
+		}
+		else if constexpr (::std::is_same_v<source, ::std::filesystem::path>)
+		{
+			read_input(img, src.string().c_str(), transform);
+		}
+		else if constexpr (::std::is_same_v<source, ::std::string>)
+		{
+			read_input(img, src.c_str(), transform);
+		}
+		else
+		{
+			read_input(img, src, transform);
+		}
+	}
+
+	/**
+	 * \brief With the default transformation image::read() is left to pick the decoder, so that 8-bit images take decode_native().
+	 */
+	template<typename input, typename transformation>
+	static inline void read_input(image_type& img, const input& in, const transformation& transform)
+	{
+		if constexpr (::std::is_same_v<transformation, typename image_type::transform_convert>)
+		{
+			img.read(in);
+		}
+		else
+		{
+			img.read(in, transform);
+		}
+	}
+
+	::std::vector<image_type> m_workers;
+};
+
+} // namespace png
+
+#endif // PNGPP_BATCH_DECODER_HPP_INCLUDED
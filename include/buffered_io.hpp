@@ -0,0 +1,208 @@
+/**********************************************************************************************************************************************\
+	Copyright© 2021 Mason DeRoss
+
+	Released under either the GNU All-permissive License or MIT license. You pick.
+
+	Copying and distribution of this file, with or without modification, are permitted in any medium without royalty,
+	provided the copyright notice and this notice are preserved. This file is offered as-is, without any warranty.
+
+	DESCRIPTION:
+		Large-block buffering adapters between the libpng read/write callbacks and user streams.
+
+\**********************************************************************************************************************************************/
+#ifndef PNGPP_BUFFERED_IO_HPP_INCLUDED
+#define PNGPP_BUFFERED_IO_HPP_INCLUDED
+
+#pragma once
+
+#include <algorithm>
+#include <concepts>
+#include <cstring>
+#include <ios>
+#include <vector>
+
+#include "types.hpp"
+#include "reader.hpp"
+
+namespace png
+{
+
+/**
+ * \brief The default block size of buffered_istream and buffered_ostream.
+ */
+inline constexpr const size_t default_io_block_size{64 * 1024};
+
+/**
+ * \brief An input stream that reports how many bytes the last read() actually transferred.
+ */
+template<typename istream>
+concept counted_input_stream = input_stream<istream> && requires(istream& stream)
+{
+	{ stream.gcount() } -> ::std::convertible_to<::std::streamsize>;
+};
+
+/**
+ * \brief Reads the underlying stream in large blocks and serves the many small libpng reads (chunk headers, CRCs) from memory.
+ *
+ * Use it to wrap a stream before handing it to image::read_stream(), consumer::read() or reader:
+ *
+ * \code
+ * png::buffered_istream<my_fd_stream> in(stream, 256 * 1024);
+ * image.read_stream(in);
+ * \endcode
+ *
+ * The reader does not buffer on its own, so the wrapper is opt-in: worth it for streams whose every read() is costly, such as a socket
+ * or an unbuffered file descriptor, and of no use for span_istream and mapped_file, which read straight from memory. Requests that are at
+ * least one block long bypass the buffer. Note the adapter reads ahead: after decoding, the underlying stream may be positioned up to one
+ * block past the end of the PNG data stream.
+ *
+ * \see buffered_ostream, reader
+ */
+template<counted_input_stream istream>
+class buffered_istream
+{
+private:
+	buffered_istream() = delete;
+
+	buffered_istream(const buffered_istream&) = delete;
+	buffered_istream(buffered_istream&&) = delete;
+
+	buffered_istream& operator=(const buffered_istream&) = delete;
+	buffered_istream& operator=(buffered_istream&&) = delete;
+
+public:
+	explicit inline buffered_istream(istream& stream, size_t block_size = default_io_block_size)
+		: m_stream(stream), m_buffer(::std::max<size_t>(block_size, 1)) {}
+
+	inline ~buffered_istream() noexcept = default;
+
+	inline void read(char* data, size_t length)
+	{
+		while (length > 0)
+		{
+			if (m_pos == m_end)
+			{
+				if (length >= m_buffer.size())
+				{
+					m_stream.read(data, length);
+					if (static_cast<size_t>(m_stream.gcount()) != length)
+					{
+						m_good = false;
+					}
+					return;
+				}
+				if (!refill())
+				{
+					m_good = false;
+					return;
+				}
+			}
+
+			size_t count{::std::min(length, m_end - m_pos)};
+			::std::memcpy(data, m_buffer.data() + m_pos, count);
+			m_pos += count;
+			data += count;
+			length -= count;
+		}
+	}
+
+	inline constexpr bool good() const noexcept
+	{
+		return m_good;
+	}
+
+private:
+	inline bool refill()
+	{
+		m_stream.read(reinterpret_cast<char*>(m_buffer.data()), m_buffer.size());
+		m_pos = 0;
+		m_end = static_cast<size_t>(m_stream.gcount());
+		return m_end > 0;
+	}
+
+	istream& m_stream;
+	::std::vector<byte> m_buffer;
+	size_t m_pos{0};
+	size_t m_end{0};
+	bool m_good{true};
+};
+
+/**
+ * \brief Collects the small libpng writes in a large block and passes them on to the underlying stream one block at a time.
+ *
+ * Call \c flush() once the image has been written; the destructor drains whatever is left but cannot report errors.
+ *
+ * \see buffered_istream, writer
+ */
+template<typename ostream>
+class buffered_ostream
+{
+private:
+	buffered_ostream() = delete;
+
+	buffered_ostream(const buffered_ostream&) = delete;
+	buffered_ostream(buffered_ostream&&) = delete;
+
+	buffered_ostream& operator=(const buffered_ostream&) = delete;
+	buffered_ostream& operator=(buffered_ostream&&) = delete;
+
+public:
+	explicit inline buffered_ostream(ostream& stream, size_t block_size = default_io_block_size) : m_stream(stream)
+	{
+		m_buffer.reserve(::std::max<size_t>(block_size, 1));
+	}
+
+	inline ~buffered_ostream() noexcept
+	{
+		try
+		{
+			drain();
+		}
+		catch (...)
+		{
+		}
+	}
+
+	inline void write(const char* data, size_t length)
+	{
+		if (m_buffer.size() + length > m_buffer.capacity())
+		{
+			drain();
+			if (length >= m_buffer.capacity())
+			{
+				m_stream.write(data, length);
+				return;
+			}
+		}
+		auto bytes{reinterpret_cast<const byte*>(data)};
+		m_buffer.insert(m_buffer.end(), bytes, bytes + length);
+	}
+
+	inline void flush()
+	{
+		drain();
+		m_stream.flush();
+	}
+
+	inline bool good() const
+	{
+		return m_stream.good();
+	}
+
+private:
+	inline void drain()
+	{
+		if (!m_buffer.empty())
+		{
+			m_stream.write(reinterpret_cast<const char*>(m_buffer.data()), m_buffer.size());
+			m_buffer.clear();
+		}
+	}
+
+	ostream& m_stream;
+	::std::vector<byte> m_buffer;
+};
+
+} // namespace png
+
+#endif // PNGPP_BUFFERED_IO_HPP_INCLUDED
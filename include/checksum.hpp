@@ -0,0 +1,367 @@
+/**********************************************************************************************************************************************\
+	Copyright© 2021 Mason DeRoss
+
+	Released under either the GNU All-permissive License or MIT license. You pick.
+
+	Copying and distribution of this file, with or without modification, are permitted in any medium without royalty,
+	provided the copyright notice and this notice are preserved. This file is offered as-is, without any warranty.
+
+	DESCRIPTION:
+		CRC-32 and Adler-32 with PCLMULQDQ, SSSE3 and AVX2 kernels picked at run time, zlib's table driven code otherwise.
+
+\**********************************************************************************************************************************************/
+#ifndef PNGPP_CHECKSUM_HPP_INCLUDED
+#define PNGPP_CHECKSUM_HPP_INCLUDED
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <span>
+
+extern "C"
+{
+	#include <zlib.h>
+}
+
+#include "config.hpp"
+#include "types.hpp"
+
+#if defined(PNGPP_CPU_DISPATCH_SUPPORTED)
+	#if defined(_MSC_VER) && !defined(__clang__)
+		#include <intrin.h>
+	#else
+		#include <cpuid.h>
+	#endif
+	#include <immintrin.h>
+#endif
+
+namespace png
+{
+
+/**
+ * \brief The instruction set extensions the checksum kernels use, as found at run time.
+ */
+struct cpu_features
+{
+	bool pclmul{false};						// PCLMULQDQ, carry-less multiplication: CRC-32
+	bool ssse3{false};						// Adler-32, 32 bytes a step
+	bool avx2{false};						// Adler-32, 64 bytes a step; includes the check that the OS saves the YMM registers
+};
+
+namespace detail
+{
+
+#if defined(PNGPP_CPU_DISPATCH_SUPPORTED)
+
+inline ::std::array<uint32_t, 4> cpuid(uint32_t leaf) noexcept
+{
+	::std::array<uint32_t, 4> regs{};		// eax, ebx, ecx, edx
+#if defined(_MSC_VER) && !defined(__clang__)
+	int out[4];
+	__cpuidex(out, static_cast<int>(leaf), 0);
+	::std::copy(out, out + 4, regs.begin());
+#else
+	if (leaf <= __get_cpuid_max(0, nullptr))
+	{
+		__cpuid_count(leaf, 0, regs[0], regs[1], regs[2], regs[3]);
+	}
+#endif
+	return regs;
+}
+
+inline uint64_t xgetbv() noexcept
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+	return _xgetbv(0);
+#else
+	uint32_t eax, edx;
+	__asm__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+}
+
+#endif
+
+inline cpu_features detect_cpu_features() noexcept
+{
+	cpu_features features;
+#if defined(PNGPP_CPU_DISPATCH_SUPPORTED)
+	const auto leaf1{cpuid(1)};
+	const bool sse2{(leaf1[3] & (1u << 26)) != 0};
+	features.pclmul = sse2 && (leaf1[2] & (1u << 1)) != 0;
+	features.ssse3 = sse2 && (leaf1[2] & (1u << 9)) != 0;
+
+	// AVX and OSXSAVE, and the OS saves the XMM and YMM state
+	if ((leaf1[2] & (1u << 27)) != 0 && (leaf1[2] & (1u << 28)) != 0 && (xgetbv() & 6) == 6)
+	{
+		features.avx2 = (cpuid(7)[1] & (1u << 5)) != 0;
+	}
+#endif
+	return features;
+}
+
+/**
+ * \brief zlib's crc32(), for any length.
+ */
+inline uint32_t crc32_zlib(uint32_t crc, const byte* data, size_t size) noexcept
+{
+	while (size != 0)
+	{
+		const uInt count{static_cast<uInt>(::std::min<size_t>(size, 1u << 30))};
+		crc = static_cast<uint32_t>(::crc32(crc, data, count));
+		data += count;
+		size -= count;
+	}
+	return crc;
+}
+
+/**
+ * \brief zlib's adler32(), for any length.
+ */
+inline uint32_t adler32_zlib(uint32_t adler, const byte* data, size_t size) noexcept
+{
+	while (size != 0)
+	{
+		const uInt count{static_cast<uInt>(::std::min<size_t>(size, 1u << 30))};
+		adler = static_cast<uint32_t>(::adler32(adler, data, count));
+		data += count;
+		size -= count;
+	}
+	return adler;
+}
+
+#if defined(PNGPP_CPU_DISPATCH_SUPPORTED)
+
+PNGPP_TARGET("sse2,pclmul")
+inline __m128i crc32_fold(__m128i x, __m128i next, __m128i k) noexcept
+{
+	return _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x, k, 0x11), next), _mm_clmulepi64_si128(x, k, 0x00));
+}
+
+/**
+ * \brief The CRC-32 of \a size bytes, at least 64 and a multiple of 16, by folding 64 bytes a step with carry-less multiplications.
+ *
+ * \a crc is the running value before the final inversion, so \c ~crc of the zlib style value, and so is the result. The constants are
+ * those of Intel's "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction", for the reflected polynomial 0xEDB88320.
+ */
+PNGPP_TARGET("sse2,pclmul")
+inline uint32_t crc32_pclmul(uint32_t crc, const byte* data, size_t size) noexcept
+{
+	const __m128i* in{reinterpret_cast<const __m128i*>(data)};
+	__m128i x1{_mm_loadu_si128(in)};
+	__m128i x2{_mm_loadu_si128(in + 1)};
+	__m128i x3{_mm_loadu_si128(in + 2)};
+	__m128i x4{_mm_loadu_si128(in + 3)};
+	x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(static_cast<int>(crc)));
+	in += 4;
+	size -= 64;
+
+	// four lanes of 16 bytes, each folded 64 bytes ahead
+	__m128i k{_mm_set_epi64x(0x01c6e41596, 0x0154442bd4)};
+	for (; size >= 64; in += 4, size -= 64)
+	{
+		x1 = crc32_fold(x1, _mm_loadu_si128(in), k);
+		x2 = crc32_fold(x2, _mm_loadu_si128(in + 1), k);
+		x3 = crc32_fold(x3, _mm_loadu_si128(in + 2), k);
+		x4 = crc32_fold(x4, _mm_loadu_si128(in + 3), k);
+	}
+
+	// the lanes into one, then the rest 16 bytes at a time
+	k = _mm_set_epi64x(0x00ccaa009e, 0x01751997d0);
+	x1 = crc32_fold(x1, x2, k);
+	x1 = crc32_fold(x1, x3, k);
+	x1 = crc32_fold(x1, x4, k);
+	for (; size >= 16; ++in, size -= 16)
+	{
+		x1 = crc32_fold(x1, _mm_loadu_si128(in), k);
+	}
+
+	// 128 bits to 64
+	const __m128i low32{_mm_setr_epi32(~0, 0, ~0, 0)};
+	x2 = _mm_clmulepi64_si128(x1, k, 0x10);
+	x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+	k = _mm_set_epi64x(0, 0x0163cd6124);
+	x2 = _mm_srli_si128(x1, 4);
+	x1 = _mm_xor_si128(_mm_clmulepi64_si128(_mm_and_si128(x1, low32), k, 0x00), x2);
+
+	// Barrett reduction to 32 bits
+	k = _mm_set_epi64x(0x01f7011641, 0x01db710641);
+	x2 = _mm_clmulepi64_si128(_mm_and_si128(x1, low32), k, 0x10);
+	x2 = _mm_clmulepi64_si128(_mm_and_si128(x2, low32), k, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+	return static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_srli_si128(x1, 4)));
+}
+
+inline constexpr const uint32_t adler_base{65521};		// the largest prime below 2^16
+inline constexpr const size_t adler_nmax{5552};			// the most bytes before s2 has to be reduced to stay within 32 bits
+
+inline uint32_t adler32_tail(uint32_t s1, uint32_t s2, const byte* data, size_t size) noexcept
+{
+	for (size_t i{0}; i < size; ++i)
+	{
+		s1 += data[i];
+		s2 += s1;
+	}
+	return (s1 % adler_base) | ((s2 % adler_base) << 16);
+}
+
+/**
+ * \brief The Adler-32 of \a size bytes, 32 bytes a step.
+ *
+ * Over a block s1 grows by the sum of the bytes, taken with \c psadbw, and s2 by the bytes weighted 32 down to 1, taken with \c pmaddubsw,
+ * plus 32 times s1 as it was in front of the block.
+ */
+PNGPP_TARGET("ssse3")
+inline uint32_t adler32_ssse3(uint32_t adler, const byte* data, size_t size) noexcept
+{
+	uint32_t s1{adler & 0xffff};
+	uint32_t s2{adler >> 16};
+
+	const __m128i tap1{_mm_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17)};
+	const __m128i tap2{_mm_setr_epi8(16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1)};
+	const __m128i zero{_mm_setzero_si128()};
+	const __m128i ones{_mm_set1_epi16(1)};
+
+	size_t blocks{size / 32};
+	size -= blocks * 32;
+	while (blocks != 0)
+	{
+		size_t n{::std::min(blocks, adler_nmax / 32)};
+		blocks -= n;
+
+		__m128i v_ps{_mm_setr_epi32(static_cast<int>(s1 * n), 0, 0, 0)};	// s1 in front of every block
+		__m128i v_s1{zero};
+		__m128i v_s2{_mm_setr_epi32(static_cast<int>(s2), 0, 0, 0)};
+		for (; n != 0; --n, data += 32)
+		{
+			const __m128i bytes1{_mm_loadu_si128(reinterpret_cast<const __m128i*>(data))};
+			const __m128i bytes2{_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16))};
+			v_ps = _mm_add_epi32(v_ps, v_s1);
+			v_s1 = _mm_add_epi32(v_s1, _mm_add_epi32(_mm_sad_epu8(bytes1, zero), _mm_sad_epu8(bytes2, zero)));
+			v_s2 = _mm_add_epi32(v_s2, _mm_madd_epi16(_mm_maddubs_epi16(bytes1, tap1), ones));
+			v_s2 = _mm_add_epi32(v_s2, _mm_madd_epi16(_mm_maddubs_epi16(bytes2, tap2), ones));
+		}
+		v_s2 = _mm_add_epi32(v_s2, _mm_slli_epi32(v_ps, 5));
+
+		v_s1 = _mm_add_epi32(v_s1, _mm_shuffle_epi32(v_s1, _MM_SHUFFLE(2, 3, 0, 1)));
+		v_s1 = _mm_add_epi32(v_s1, _mm_shuffle_epi32(v_s1, _MM_SHUFFLE(1, 0, 3, 2)));
+		v_s2 = _mm_add_epi32(v_s2, _mm_shuffle_epi32(v_s2, _MM_SHUFFLE(2, 3, 0, 1)));
+		v_s2 = _mm_add_epi32(v_s2, _mm_shuffle_epi32(v_s2, _MM_SHUFFLE(1, 0, 3, 2)));
+		s1 = (s1 + static_cast<uint32_t>(_mm_cvtsi128_si32(v_s1))) % adler_base;
+		s2 = static_cast<uint32_t>(_mm_cvtsi128_si32(v_s2)) % adler_base;
+	}
+	return adler32_tail(s1, s2, data, size);
+}
+
+PNGPP_TARGET("avx2")
+inline uint32_t horizontal_sum(__m256i v) noexcept
+{
+	__m128i x{_mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1))};
+	x = _mm_add_epi32(x, _mm_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1)));
+	x = _mm_add_epi32(x, _mm_shuffle_epi32(x, _MM_SHUFFLE(1, 0, 3, 2)));
+	return static_cast<uint32_t>(_mm_cvtsi128_si32(x));
+}
+
+/**
+ * \brief adler32_ssse3() with 64 bytes a step.
+ */
+PNGPP_TARGET("avx2")
+inline uint32_t adler32_avx2(uint32_t adler, const byte* data, size_t size) noexcept
+{
+	uint32_t s1{adler & 0xffff};
+	uint32_t s2{adler >> 16};
+
+	const __m256i tap1{_mm256_setr_epi8(64, 63, 62, 61, 60, 59, 58, 57, 56, 55, 54, 53, 52, 51, 50, 49,
+		48, 47, 46, 45, 44, 43, 42, 41, 40, 39, 38, 37, 36, 35, 34, 33)};
+	const __m256i tap2{_mm256_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17,
+		16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1)};
+	const __m256i zero{_mm256_setzero_si256()};
+	const __m256i ones{_mm256_set1_epi16(1)};
+
+	size_t blocks{size / 64};
+	size -= blocks * 64;
+	while (blocks != 0)
+	{
+		size_t n{::std::min(blocks, adler_nmax / 64)};
+		blocks -= n;
+
+		__m256i v_ps{_mm256_setr_epi32(static_cast<int>(s1 * n), 0, 0, 0, 0, 0, 0, 0)};
+		__m256i v_s1{zero};
+		__m256i v_s2{_mm256_setr_epi32(static_cast<int>(s2), 0, 0, 0, 0, 0, 0, 0)};
+		for (; n != 0; --n, data += 64)
+		{
+			const __m256i bytes1{_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data))};
+			const __m256i bytes2{_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + 32))};
+			v_ps = _mm256_add_epi32(v_ps, v_s1);
+			v_s1 = _mm256_add_epi32(v_s1, _mm256_add_epi32(_mm256_sad_epu8(bytes1, zero), _mm256_sad_epu8(bytes2, zero)));
+			v_s2 = _mm256_add_epi32(v_s2, _mm256_madd_epi16(_mm256_maddubs_epi16(bytes1, tap1), ones));
+			v_s2 = _mm256_add_epi32(v_s2, _mm256_madd_epi16(_mm256_maddubs_epi16(bytes2, tap2), ones));
+		}
+		v_s2 = _mm256_add_epi32(v_s2, _mm256_slli_epi32(v_ps, 6));
+
+		s1 = (s1 + horizontal_sum(v_s1)) % adler_base;
+		s2 = horizontal_sum(v_s2) % adler_base;
+	}
+	return adler32_tail(s1, s2, data, size);
+}
+
+#endif
+
+} // namespace detail
+
+/**
+ * \brief Returns the instruction set extensions found on this CPU, detected on the first call.
+ */
+inline const cpu_features& get_cpu_features() noexcept
+{
+	static const cpu_features features{detail::detect_cpu_features()};
+	return features;
+}
+
+/**
+ * \brief The CRC-32 of \a bytes, as used by the PNG chunks and by zlib's \c crc32(): pass the CRC of the bytes in front as \a crc to
+ * continue it.
+ *
+ * With PCLMULQDQ all but the last few bytes are folded in 64 bytes a step, several times faster than zlib's tables.
+ */
+inline uint32_t crc32(::std::span<const byte> bytes, uint32_t crc = 0) noexcept
+{
+#if defined(PNGPP_CPU_DISPATCH_SUPPORTED)
+	if (bytes.size() >= 64 && get_cpu_features().pclmul)
+	{
+		const size_t folded{bytes.size() & ~size_t{15}};
+		crc = ~detail::crc32_pclmul(~crc, bytes.data(), folded);
+		bytes = bytes.subspan(folded);
+	}
+#endif
+	return detail::crc32_zlib(crc, bytes.data(), bytes.size());
+}
+
+/**
+ * \brief The Adler-32 of \a bytes, as in the trailer of a zlib stream and zlib's \c adler32(): pass the Adler-32 of the bytes in front as
+ * \a adler to continue it.
+ *
+ * Uses AVX2 or SSSE3 when the CPU has them.
+ */
+inline uint32_t adler32(::std::span<const byte> bytes, uint32_t adler = 1) noexcept
+{
+#if defined(PNGPP_CPU_DISPATCH_SUPPORTED)
+	if (bytes.size() >= 64)
+	{
+		if (get_cpu_features().avx2)
+		{
+			return detail::adler32_avx2(adler, bytes.data(), bytes.size());
+		}
+		if (get_cpu_features().ssse3)
+		{
+			return detail::adler32_ssse3(adler, bytes.data(), bytes.size());
+		}
+	}
+#endif
+	return detail::adler32_zlib(adler, bytes.data(), bytes.size());
+}
+
+} // namespace png
+
+#endif // PNGPP_CHECKSUM_HPP_INCLUDED
@@ -0,0 +1,201 @@
+/**********************************************************************************************************************************************\
+	Copyright© 2021 Mason DeRoss
+
+	Released under either the GNU All-permissive License or MIT license. You pick.
+
+	Copying and distribution of this file, with or without modification, are permitted in any medium without royalty,
+	provided the copyright notice and this notice are preserved. This file is offered as-is, without any warranty.
+
+	DESCRIPTION:
+		Primitives for working on the PNG data stream directly: signature, chunk types and big-endian integers.
+
+\**********************************************************************************************************************************************/
+#ifndef PNGPP_CHUNK_HPP_INCLUDED
+#define PNGPP_CHUNK_HPP_INCLUDED
+
+#pragma once
+
+#include <array>
+#include <algorithm>
+#include <span>
+#include <string_view>
+#include <vector>
+
+extern "C"
+{
+	#include <zlib.h>
+}
+
+#include "types.hpp"
+#include "error.hpp"
+#include "checksum.hpp"
+
+namespace png
+{
+
+/**
+ * \brief The eight bytes every PNG data stream starts with.
+ */
+inline constexpr const ::std::array<byte, 8> png_signature{137, 80, 78, 71, 13, 10, 26, 10};
+
+/**
+ * \brief The length, type and CRC fields around the data of every chunk.
+ */
+inline constexpr const size_t chunk_overhead{12};
+
+/**
+ * \brief A chunk type: its four ASCII letters packed big-endian, so \c "IHDR" becomes \c 0x49484452.
+ */
+using chunk_type = uint32_t;
+
+inline constexpr chunk_type make_chunk_type(::std::string_view name) noexcept
+{
+	return (static_cast<chunk_type>(static_cast<byte>(name[0])) << 24) | (static_cast<chunk_type>(static_cast<byte>(name[1])) << 16)
+		| (static_cast<chunk_type>(static_cast<byte>(name[2])) << 8) | static_cast<chunk_type>(static_cast<byte>(name[3]));
+}
+
+inline constexpr const chunk_type chunk_type_IHDR{make_chunk_type("IHDR")};
+inline constexpr const chunk_type chunk_type_PLTE{make_chunk_type("PLTE")};
+inline constexpr const chunk_type chunk_type_IDAT{make_chunk_type("IDAT")};
+inline constexpr const chunk_type chunk_type_IEND{make_chunk_type("IEND")};
+inline constexpr const chunk_type chunk_type_tRNS{make_chunk_type("tRNS")};
+inline constexpr const chunk_type chunk_type_gAMA{make_chunk_type("gAMA")};
+inline constexpr const chunk_type chunk_type_cHRM{make_chunk_type("cHRM")};
+inline constexpr const chunk_type chunk_type_sRGB{make_chunk_type("sRGB")};
+inline constexpr const chunk_type chunk_type_iCCP{make_chunk_type("iCCP")};
+inline constexpr const chunk_type chunk_type_pHYs{make_chunk_type("pHYs")};
+inline constexpr const chunk_type chunk_type_tEXt{make_chunk_type("tEXt")};
+inline constexpr const chunk_type chunk_type_zTXt{make_chunk_type("zTXt")};
+inline constexpr const chunk_type chunk_type_iTXt{make_chunk_type("iTXt")};
+inline constexpr const chunk_type chunk_type_eXIf{make_chunk_type("eXIf")};
+inline constexpr const chunk_type chunk_type_sBIT{make_chunk_type("sBIT")};
+inline constexpr const chunk_type chunk_type_bKGD{make_chunk_type("bKGD")};
+inline constexpr const chunk_type chunk_type_hIST{make_chunk_type("hIST")};
+inline constexpr const chunk_type chunk_type_sPLT{make_chunk_type("sPLT")};
+inline constexpr const chunk_type chunk_type_tIME{make_chunk_type("tIME")};
+
+/**
+ * \brief Ancillary chunks have a lower case first letter; decoders may ignore them.
+ */
+inline constexpr bool is_ancillary(chunk_type type) noexcept
+{
+	return (type & 0x20000000u) != 0;
+}
+
+/**
+ * \brief Returns the four letters of \a type.
+ */
+inline constexpr ::std::array<char, 4> get_chunk_name(chunk_type type) noexcept
+{
+	return {static_cast<char>(type >> 24), static_cast<char>(type >> 16), static_cast<char>(type >> 8), static_cast<char>(type)};
+}
+
+inline constexpr uint32_t load_be32(const byte* bytes) noexcept
+{
+	return (static_cast<uint32_t>(bytes[0]) << 24) | (static_cast<uint32_t>(bytes[1]) << 16)
+		| (static_cast<uint32_t>(bytes[2]) << 8) | static_cast<uint32_t>(bytes[3]);
+}
+
+inline constexpr uint16_t load_be16(const byte* bytes) noexcept
+{
+	return static_cast<uint16_t>((bytes[0] << 8) | bytes[1]);
+}
+
+inline constexpr void store_be32(byte* bytes, uint32_t value) noexcept
+{
+	bytes[0] = static_cast<byte>(value >> 24);
+	bytes[1] = static_cast<byte>(value >> 16);
+	bytes[2] = static_cast<byte>(value >> 8);
+	bytes[3] = static_cast<byte>(value);
+}
+
+/**
+ * \brief Returns \c true if \a bytes starts with the PNG signature.
+ */
+inline constexpr bool has_png_signature(::std::span<const byte> bytes) noexcept
+{
+	return bytes.size() >= png_signature.size() && ::std::equal(png_signature.begin(), png_signature.end(), bytes.begin());
+}
+
+/**
+ * \brief Writes one chunk (length, type, \a data and CRC) to \a stream, an \c ostream as expected by the writer class.
+ */
+template<typename ostream>
+inline void write_chunk(ostream& stream, chunk_type type, ::std::span<const byte> data)
+{
+	if (data.size() > PNG_UINT_31_MAX)
+	{
+		throw error("write_chunk: chunk data too long");
+	}
+
+	::std::array<byte, 8> head;
+	store_be32(head.data(), static_cast<uint32_t>(data.size()));
+	store_be32(head.data() + 4, type);
+
+	const uint32_t crc{crc32(data, crc32(::std::span(head).last(4)))};
+	::std::array<byte, 4> tail;
+	store_be32(tail.data(), crc);
+
+	stream.write(reinterpret_cast<const char*>(head.data()), head.size());
+	stream.write(reinterpret_cast<const char*>(data.data()), data.size());
+	stream.write(reinterpret_cast<const char*>(tail.data()), tail.size());
+	if (!stream.good())
+	{
+		throw error("write_chunk: ostream::write() failed");
+	}
+}
+
+/**
+ * \brief Cuts a zlib stream written in pieces of any size into IDAT chunks of at most \c chunk_size bytes.
+ */
+template<typename ostream>
+class idat_writer
+{
+private:
+	idat_writer(const idat_writer&) = delete;
+	idat_writer(idat_writer&&) = delete;
+
+	idat_writer& operator=(const idat_writer&) = delete;
+	idat_writer& operator=(idat_writer&&) = delete;
+
+public:
+	explicit inline idat_writer(ostream& stream, size_t chunk_size = 1 << 16) : m_stream(stream), m_chunk_size(chunk_size ? chunk_size : 1)
+	{
+		m_buffer.reserve(m_chunk_size);
+	}
+
+	inline void write(::std::span<const byte> bytes)
+	{
+		while (!bytes.empty())
+		{
+			const size_t count{::std::min(bytes.size(), m_chunk_size - m_buffer.size())};
+			m_buffer.insert(m_buffer.end(), bytes.begin(), bytes.begin() + count);
+			bytes = bytes.subspan(count);
+			if (m_buffer.size() == m_chunk_size)
+			{
+				flush();
+			}
+		}
+	}
+
+	/**
+	 * \brief Writes whatever is buffered as a (possibly short) IDAT chunk.
+	 */
+	inline void flush()
+	{
+		if (!m_buffer.empty())
+		{
+			write_chunk(m_stream, chunk_type_IDAT, m_buffer);
+			m_buffer.clear();
+		}
+	}
+
+private:
+	ostream& m_stream;
+	size_t m_chunk_size;
+	::std::vector<byte> m_buffer;
+};
+
+} // namespace png
+
+#endif // PNGPP_CHUNK_HPP_INCLUDED
@@ -0,0 +1,382 @@
+/**********************************************************************************************************************************************\
+	Copyright© 2021 Mason DeRoss
+
+	Released under either the GNU All-permissive License or MIT license. You pick.
+
+	Copying and distribution of this file, with or without modification, are permitted in any medium without royalty,
+	provided the copyright notice and this notice are preserved. This file is offered as-is, without any warranty.
+
+	DESCRIPTION:
+		Metadata edits on a PNG data stream: chunks added, replaced or stripped, everything else, IDAT included, copied byte for byte.
+
+\**********************************************************************************************************************************************/
+#ifndef PNGPP_CHUNK_EDITOR_HPP_INCLUDED
+#define PNGPP_CHUNK_EDITOR_HPP_INCLUDED
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <fstream>
+#include <span>
+#include <string_view>
+#include <vector>
+
+extern "C"
+{
+	#include <zlib.h>
+}
+
+#include "types.hpp"
+#include "error.hpp"
+#include "palette.hpp"
+#include "tRNS.hpp"
+#include "chunk.hpp"
+#include "chunk_scanner.hpp"
+#include "buffered_io.hpp"
+
+namespace png
+{
+
+/**
+ * \brief Adds, replaces and strips the ancillary chunks, and PLTE, of a PNG data stream without decoding it.
+ *
+ * The chunks left alone, the image data among them, are written out exactly as they were read, CRCs included; only the CRCs of the new
+ * chunks are computed. New chunks go where the specification wants them: cHRM, gAMA, iCCP, sBIT and sRGB in front of PLTE, PLTE in
+ * front of tRNS, bKGD and hIST, and everything else in front of the first IDAT. A replaced chunk keeps its place.
+ *
+ * \code
+ * mapped_file file("in.png");
+ * chunk_editor editor(file.get_bytes());
+ * editor.strip(chunk_type_eXIf);
+ * editor.set_text("Copyright", "ACME");
+ * editor.write("out.png");
+ * \endcode
+ *
+ * The editor points into \a bytes, which has to stay alive and unchanged until the last write.
+ */
+class chunk_editor
+{
+public:
+	/**
+	 * \brief Indexes the chunks of \a bytes. Throws png::error unless it is a complete PNG data stream with image data.
+	 *
+	 * CRCs are not checked: chunks that are not edited go out as they came in.
+	 */
+	explicit inline chunk_editor(::std::span<const byte> bytes)
+	{
+		const auto index{scan_chunks(bytes, scan_options{false})};
+		if (index.is_truncated || !index.has_iend || index.idat_runs.empty())
+		{
+			throw error("chunk_editor: incomplete PNG data stream");
+		}
+		m_color_type = index.info.get_color_type();
+		for (const auto& record : index.chunks)
+		{
+			m_chunks.push_back({record.chunk.type, bytes.subspan(record.chunk.offset, record.chunk.get_size()), {}});
+		}
+	}
+
+	/**
+	 * \brief Returns \c true if the data stream has a chunk of type \a type.
+	 */
+	inline bool contains(chunk_type type) const noexcept
+	{
+		return ::std::ranges::any_of(m_chunks, [type](const entry& e){ return e.type == type; });
+	}
+
+	/**
+	 * \brief Returns the data of the first chunk of type \a type, empty if there is none.
+	 */
+	inline ::std::span<const byte> get_data(chunk_type type) const noexcept
+	{
+		auto it{::std::ranges::find(m_chunks, type, &entry::type)};
+		return it == m_chunks.end() ? ::std::span<const byte>() : it->get_data();
+	}
+
+	/**
+	 * \brief Sets the data of the chunk of type \a type: the first one is replaced in place and any others are removed, or a new one is
+	 * added if there is none.
+	 */
+	inline void set(chunk_type type, ::std::span<const byte> data)
+	{
+		check_editable(type);
+		auto it{::std::ranges::find(m_chunks, type, &entry::type)};
+		if (it == m_chunks.end())
+		{
+			insert(type, data);
+			return;
+		}
+		*it = {type, {}, ::std::vector<byte>(data.begin(), data.end())};
+		m_chunks.erase(::std::remove_if(it + 1, m_chunks.end(), [type](const entry& e){ return e.type == type; }), m_chunks.end());
+	}
+
+	/**
+	 * \brief Adds a chunk of type \a type next to the ones there may already be, for the types that can appear more than once such as the
+	 * text chunks and sPLT.
+	 */
+	inline void add(chunk_type type, ::std::span<const byte> data)
+	{
+		check_editable(type);
+		insert(type, data);
+	}
+
+	/**
+	 * \brief Removes every chunk of type \a type. PLTE can only be removed from images that are not palette images.
+	 */
+	inline void strip(chunk_type type)
+	{
+		check_editable(type);
+		if (type == chunk_type_PLTE && m_color_type == color_type_palette)
+		{
+			throw error("chunk_editor: a palette image needs its PLTE chunk");
+		}
+		::std::erase_if(m_chunks, [type](const entry& e){ return e.type == type; });
+	}
+
+	/**
+	 * \brief Removes every text chunk, tEXt, zTXt and iTXt.
+	 */
+	inline void strip_text()
+	{
+		::std::erase_if(m_chunks, [](const entry& e){ return is_text(e.type); });
+	}
+
+	/**
+	 * \brief Removes the text chunks whose keyword is \a keyword.
+	 */
+	inline void strip_text(::std::string_view keyword)
+	{
+		::std::erase_if(m_chunks, [keyword](const entry& e){ return is_text(e.type) && detail::split_keyword(e.get_data()).first == keyword; });
+	}
+
+	/**
+	 * \brief Replaces the text chunks whose keyword is \a keyword with one tEXt chunk, Latin-1 \a text, in place of the first of them.
+	 */
+	inline void set_text(::std::string_view keyword, ::std::string_view text)
+	{
+		check_keyword(keyword);
+		auto it{::std::ranges::find_if(m_chunks, [keyword](const entry& e)
+		{
+			return is_text(e.type) && detail::split_keyword(e.get_data()).first == keyword;
+		})};
+		if (it == m_chunks.end())
+		{
+			add_text(keyword, text);
+			return;
+		}
+		*it = {chunk_type_tEXt, {}, make_text(keyword, text)};
+		m_chunks.erase(::std::remove_if(it + 1, m_chunks.end(), [keyword](const entry& e)
+		{
+			return is_text(e.type) && detail::split_keyword(e.get_data()).first == keyword;
+		}), m_chunks.end());
+	}
+
+	/**
+	 * \brief Adds a tEXt chunk, \a keyword and Latin-1 \a text.
+	 */
+	inline void add_text(::std::string_view keyword, ::std::string_view text)
+	{
+		check_keyword(keyword);
+		insert(chunk_type_tEXt, make_text(keyword, text));
+	}
+
+	/**
+	 * \brief Sets the gAMA chunk to the file gamma \a gamma, 1 / 2.2 for most images.
+	 */
+	inline void set_gamma(double gamma)
+	{
+		::std::array<byte, 4> data;
+		store_be32(data.data(), static_cast<uint32_t>(::std::lround(gamma * 100000)));
+		set(chunk_type_gAMA, data);
+	}
+
+	/**
+	 * \brief Sets the sRGB chunk with rendering intent \a intent (0 to 3) and removes iCCP, which it excludes.
+	 */
+	inline void set_sRGB(int intent)
+	{
+		const ::std::array<byte, 1> data{static_cast<byte>(intent)};
+		set(chunk_type_sRGB, data);
+		::std::erase_if(m_chunks, [](const entry& e){ return e.type == chunk_type_iCCP; });
+	}
+
+	/**
+	 * \brief Sets the iCCP chunk to the ICC profile \a profile, compressed here, named \a name, and removes sRGB, which it excludes.
+	 */
+	inline void set_iCCP(::std::string_view name, ::std::span<const byte> profile)
+	{
+		check_keyword(name);
+		::std::vector<byte> data(name.begin(), name.end());
+		data.push_back(0);
+		data.push_back(0);						// compression method: deflate
+		uLongf size{::compressBound(static_cast<uLong>(profile.size()))};
+		const size_t front{data.size()};
+		data.resize(front + size);
+		if (::compress2(data.data() + front, &size, profile.data(), static_cast<uLong>(profile.size()), Z_BEST_COMPRESSION) != Z_OK)
+		{
+			throw error("chunk_editor: compress2() failed");
+		}
+		data.resize(front + size);
+		set(chunk_type_iCCP, data);
+		::std::erase_if(m_chunks, [](const entry& e){ return e.type == chunk_type_sRGB; });
+	}
+
+	/**
+	 * \brief Sets the pHYs chunk.
+	 */
+	inline void set_pHYs(const physical_dimensions& phys)
+	{
+		::std::array<byte, 9> data;
+		store_be32(data.data(), phys.x);
+		store_be32(data.data() + 4, phys.y);
+		data[8] = phys.unit;
+		set(chunk_type_pHYs, data);
+	}
+
+	/**
+	 * \brief Sets the eXIf chunk to the Exif data \a exif, starting with the TIFF header.
+	 */
+	inline void set_eXIf(::std::span<const byte> exif)
+	{
+		set(chunk_type_eXIf, exif);
+	}
+
+	/**
+	 * \brief Sets the PLTE chunk, for a palette swap or as the suggested palette of a truecolor image. 1 to 256 entries.
+	 */
+	inline void set_palette(const palette& entries)
+	{
+		if (entries.empty() || entries.size() > 256)
+		{
+			throw error("chunk_editor: a palette has 1 to 256 entries");
+		}
+		::std::vector<byte> data;
+		data.reserve(3 * entries.size());
+		for (const color& c : entries)
+		{
+			data.insert(data.end(), {c.red, c.green, c.blue});
+		}
+		set(chunk_type_PLTE, data);
+	}
+
+	/**
+	 * \brief Sets the tRNS chunk, the alpha of each palette entry for palette images.
+	 */
+	inline void set_tRNS(const tRNS& trns)
+	{
+		set(chunk_type_tRNS, trns);
+	}
+
+	/**
+	 * \brief Writes the edited data stream to \a stream, an \c ostream as expected by the writer class.
+	 */
+	template<typename ostream>
+	inline void write_stream(ostream& stream) const
+	{
+		stream.write(reinterpret_cast<const char*>(png_signature.data()), png_signature.size());
+		for (const auto& e : m_chunks)
+		{
+			if (!e.original.empty())
+			{
+				stream.write(reinterpret_cast<const char*>(e.original.data()), e.original.size());
+			}
+			else
+			{
+				write_chunk(stream, e.type, e.data);
+			}
+		}
+		if (!stream.good())
+		{
+			throw error("chunk_editor: write failed");
+		}
+	}
+
+	/**
+	 * \brief Writes the edited data stream to the file \a filename, which must not be the file the editor reads from.
+	 */
+	inline void write(const char* filename) const
+	{
+		std::ofstream stream(filename, std::ios::binary);
+		if (!stream.is_open())
+		{
+			throw std_error(filename);
+		}
+		stream.exceptions(std::ios::badbit);
+		buffered_ostream<std::ofstream> buffered(stream);
+		write_stream(buffered);
+		buffered.flush();
+	}
+
+private:
+	struct entry
+	{
+		chunk_type type;
+		::std::span<const byte> original;		// the whole chunk as read, CRC included; empty for a new chunk
+		::std::vector<byte> data;				// the data of a new chunk
+
+		inline ::std::span<const byte> get_data() const noexcept
+		{
+			return original.empty() ? ::std::span<const byte>(data) : original.subspan(8, original.size() - chunk_overhead);
+		}
+	};
+
+	static inline constexpr bool is_text(chunk_type type) noexcept
+	{
+		return type == chunk_type_tEXt || type == chunk_type_zTXt || type == chunk_type_iTXt;
+	}
+
+	static inline void check_editable(chunk_type type)
+	{
+		if (type == chunk_type_IHDR || type == chunk_type_IDAT || type == chunk_type_IEND)
+		{
+			throw error("chunk_editor: IHDR, IDAT and IEND cannot be edited");
+		}
+	}
+
+	static inline void check_keyword(::std::string_view keyword)
+	{
+		if (keyword.empty() || keyword.size() > 79 || keyword.find('\0') != ::std::string_view::npos)
+		{
+			throw error("chunk_editor: a keyword has 1 to 79 characters");
+		}
+	}
+
+	static inline ::std::vector<byte> make_text(::std::string_view keyword, ::std::string_view text)
+	{
+		::std::vector<byte> data(keyword.begin(), keyword.end());
+		data.push_back(0);
+		data.insert(data.end(), text.begin(), text.end());
+		return data;
+	}
+
+	/**
+	 * \brief Inserts a new chunk in front of the first chunk it has to precede.
+	 */
+	inline void insert(chunk_type type, ::std::span<const byte> data)
+	{
+		const bool before_plte{type == chunk_type_cHRM || type == chunk_type_gAMA || type == chunk_type_iCCP || type == chunk_type_sBIT
+			|| type == chunk_type_sRGB};
+		auto it{::std::ranges::find_if(m_chunks, [type, before_plte](const entry& e)
+		{
+			if (e.type == chunk_type_IDAT)
+			{
+				return true;
+			}
+			if (type == chunk_type_PLTE)
+			{
+				return e.type == chunk_type_tRNS || e.type == chunk_type_bKGD || e.type == chunk_type_hIST;
+			}
+			return before_plte && e.type == chunk_type_PLTE;
+		})};
+		m_chunks.insert(it, entry{type, {}, ::std::vector<byte>(data.begin(), data.end())});
+	}
+
+	color_type m_color_type;
+	::std::vector<entry> m_chunks;
+};
+
+} // namespace png
+
+#endif // PNGPP_CHUNK_EDITOR_HPP_INCLUDED
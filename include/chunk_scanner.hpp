@@ -0,0 +1,433 @@
+/**********************************************************************************************************************************************\
+	Copyright© 2021 Mason DeRoss
+
+	Released under either the GNU All-permissive License or MIT license. You pick.
+
+	Copying and distribution of this file, with or without modification, are permitted in any medium without royalty,
+	provided the copyright notice and this notice are preserved. This file is offered as-is, without any warranty.
+
+	DESCRIPTION:
+		Walks the chunks of an in-memory PNG data stream and indexes them without inflating any image data.
+
+\**********************************************************************************************************************************************/
+#ifndef PNGPP_CHUNK_SCANNER_HPP_INCLUDED
+#define PNGPP_CHUNK_SCANNER_HPP_INCLUDED
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <iterator>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+extern "C"
+{
+	#include <zlib.h>
+}
+
+#include "types.hpp"
+#include "error.hpp"
+#include "chunk.hpp"
+#include "probe.hpp"
+
+namespace png
+{
+
+/**
+ * \brief One chunk of a PNG data stream, pointing into the scanned buffer.
+ */
+struct chunk_view
+{
+	chunk_type type{0};
+	size_t offset{0};						// of the length field, from the start of the data stream
+	::std::span<const byte> data;			// the chunk data, without length, type and CRC
+	uint32_t crc{0};						// as stored in the data stream
+
+	/**
+	 * \brief Returns the total size of the chunk in the data stream, including length, type and CRC.
+	 */
+	inline constexpr size_t get_size() const noexcept
+	{
+		return data.size() + chunk_overhead;
+	}
+
+	/**
+	 * \brief Computes the CRC over the chunk type and data and compares it with the stored one.
+	 */
+	inline bool check_crc() const noexcept
+	{
+		::std::array<byte, 4> name;
+		store_be32(name.data(), type);
+		return crc32(data, crc32(name)) == crc;
+	}
+};
+
+/**
+ * \brief Forward iterator over the chunks of a PNG data stream.
+ *
+ * Stops after IEND or at the first chunk that does not fit in the buffer; \c is_truncated() tells the two apart.
+ *
+ * \see chunk_range
+ */
+class chunk_iterator
+{
+public:
+	using iterator_category = ::std::forward_iterator_tag;
+	using value_type = chunk_view;
+	using difference_type = ::std::ptrdiff_t;
+	using pointer = const chunk_view*;
+	using reference = const chunk_view&;
+
+	/**
+	 * \brief Constructs the end iterator.
+	 */
+	inline constexpr chunk_iterator() noexcept = default;
+
+	/**
+	 * \brief Constructs an iterator to the chunk at \a offset in \a bytes.
+	 */
+	inline chunk_iterator(::std::span<const byte> bytes, size_t offset) noexcept : m_bytes(bytes), m_offset(offset)
+	{
+		load();
+	}
+
+	inline constexpr reference operator*() const noexcept
+	{
+		return m_chunk;
+	}
+
+	inline constexpr pointer operator->() const noexcept
+	{
+		return &m_chunk;
+	}
+
+	inline chunk_iterator& operator++() noexcept
+	{
+		if (m_chunk.type == chunk_type_IEND)
+		{
+			m_at_end = true;
+		}
+		else
+		{
+			m_offset += m_chunk.get_size();
+			load();
+		}
+		return *this;
+	}
+
+	inline chunk_iterator operator++(int) noexcept
+	{
+		auto tmp{*this};
+		++*this;
+		return tmp;
+	}
+
+	inline constexpr bool operator==(const chunk_iterator& other) const noexcept
+	{
+		return m_at_end == other.m_at_end && (m_at_end || m_offset == other.m_offset);
+	}
+
+	/**
+	 * \brief Returns \c true if iteration stopped because the next chunk runs past the end of the buffer.
+	 */
+	inline constexpr bool is_truncated() const noexcept
+	{
+		return m_truncated;
+	}
+
+	/**
+	 * \brief Returns the offset of the current chunk, or of the truncated one.
+	 */
+	inline constexpr size_t get_offset() const noexcept
+	{
+		return m_offset;
+	}
+
+private:
+	inline void load() noexcept
+	{
+		if (m_bytes.size() < m_offset + chunk_overhead)
+		{
+			m_at_end = true;
+			m_truncated = m_offset != m_bytes.size();
+			return;
+		}
+
+		const byte* head{m_bytes.data() + m_offset};
+		const uint32_t length{load_be32(head)};
+		if (length > PNG_UINT_31_MAX || m_bytes.size() - m_offset - chunk_overhead < length)
+		{
+			m_at_end = true;
+			m_truncated = true;
+			return;
+		}
+
+		m_at_end = false;
+		m_chunk.type = load_be32(head + 4);
+		m_chunk.offset = m_offset;
+		m_chunk.data = m_bytes.subspan(m_offset + 8, length);
+		m_chunk.crc = load_be32(head + 8 + length);
+	}
+
+	::std::span<const byte> m_bytes;
+	size_t m_offset{0};
+	chunk_view m_chunk;
+	bool m_at_end{true};
+	bool m_truncated{false};
+};
+
+/**
+ * \brief The chunks of a PNG data stream as a range, for use with range-based \c for.
+ */
+class chunk_range
+{
+public:
+	/**
+	 * \brief Throws png::error if \a bytes does not start with the PNG signature.
+	 */
+	explicit inline chunk_range(::std::span<const byte> bytes) : m_bytes(bytes)
+	{
+		if (!has_png_signature(bytes))
+		{
+			throw error("chunk_range: not a PNG data stream");
+		}
+	}
+
+	inline chunk_iterator begin() const noexcept
+	{
+		return chunk_iterator(m_bytes, png_signature.size());
+	}
+
+	inline constexpr chunk_iterator end() const noexcept
+	{
+		return chunk_iterator();
+	}
+
+private:
+	::std::span<const byte> m_bytes;
+};
+
+/**
+ * \brief An index entry for one chunk.
+ */
+struct chunk_record
+{
+	chunk_view chunk;
+	bool crc_ok{true};						// always \c true when the CRCs were not checked
+};
+
+/**
+ * \brief A run of consecutive IDAT chunks, i.e. one piece of the zlib stream holding the image data.
+ */
+struct idat_run
+{
+	size_t first{0};						// index of the first IDAT chunk in chunk_index::chunks
+	size_t count{0};						// number of IDAT chunks in the run
+	size_t begin{0};						// offset of the first IDAT chunk in the data stream
+	size_t end{0};							// offset just past the last IDAT chunk
+	size_t data_size{0};					// sum of the IDAT payload sizes
+};
+
+/**
+ * \brief A tEXt (or uncompressed iTXt) entry, pointing into the scanned buffer.
+ */
+struct text_entry
+{
+	::std::string_view keyword;
+	::std::string_view text;
+};
+
+/**
+ * \brief The contents of a pHYs chunk.
+ */
+struct physical_dimensions
+{
+	uint32_t x{0};
+	uint32_t y{0};
+	byte unit{0};							// 1: pixels per metre, 0: aspect ratio only
+};
+
+/**
+ * \brief The header of an iCCP chunk; the profile itself stays compressed.
+ */
+struct iccp_header
+{
+	::std::string_view name;
+	byte compression{0};
+	::std::span<const byte> profile;		// compressed profile data
+};
+
+/**
+ * \brief Options for scan_chunks().
+ */
+struct scan_options
+{
+	bool verify_crc{true};
+};
+
+/**
+ * \brief The result of scan_chunks(): every chunk of the data stream plus the small ancillary data worth having at hand.
+ *
+ * All spans and string views point into the scanned buffer.
+ */
+struct chunk_index
+{
+	image_info info;						// from IHDR
+	::std::vector<chunk_record> chunks;
+	::std::vector<idat_run> idat_runs;		// more than one run means IDAT is interrupted by other chunks
+	::std::vector<text_entry> texts;
+	::std::optional<physical_dimensions> phys;
+	::std::optional<iccp_header> iccp;
+	::std::span<const byte> exif;
+	bool has_iend{false};
+	bool is_truncated{false};
+
+	/**
+	 * \brief Returns \c true if every checked CRC matched.
+	 */
+	inline bool is_crc_ok() const noexcept
+	{
+		return ::std::ranges::all_of(chunks, [](const chunk_record& r){ return r.crc_ok; });
+	}
+
+	/**
+	 * \brief Returns the payloads of all IDAT chunks in order; concatenated they form the zlib stream.
+	 */
+	inline ::std::vector<::std::span<const byte>> get_idat() const
+	{
+		::std::vector<::std::span<const byte>> spans;
+		for (const auto& r : chunks)
+		{
+			if (r.chunk.type == chunk_type_IDAT)
+			{
+				spans.push_back(r.chunk.data);
+			}
+		}
+		return spans;
+	}
+
+	/**
+	 * \brief Returns the first chunk of type \a type, if any.
+	 */
+	inline const chunk_record* find(chunk_type type) const noexcept
+	{
+		auto it{::std::ranges::find_if(chunks, [type](const chunk_record& r){ return r.chunk.type == type; })};
+		return it == chunks.end() ? nullptr : &*it;
+	}
+};
+
+namespace detail
+{
+
+/**
+ * \brief Splits a Latin-1 keyword from the rest of a text chunk at the first NUL.
+ */
+inline ::std::pair<::std::string_view, ::std::span<const byte>> split_keyword(::std::span<const byte> data) noexcept
+{
+	auto nul{::std::ranges::find(data, byte{0})};
+	::std::string_view keyword(reinterpret_cast<const char*>(data.data()), static_cast<size_t>(nul - data.begin()));
+	if (nul == data.end())
+	{
+		return {keyword, {}};
+	}
+	return {keyword, data.subspan(keyword.size() + 1)};
+}
+
+inline ::std::string_view as_text(::std::span<const byte> data) noexcept
+{
+	return {reinterpret_cast<const char*>(data.data()), data.size()};
+}
+
+} // namespace detail
+
+/**
+ * \brief Indexes the chunks of the PNG data stream in \a bytes (an in-memory buffer or a mapped_file) without inflating IDAT.
+ *
+ * Records type, offset, length and CRC status of every chunk, where each IDAT run starts and ends, and extracts IHDR, pHYs, tEXt,
+ * uncompressed iTXt, eXIf and the iCCP header. Throws png::error if the data does not start with a valid signature and IHDR; a stream
+ * cut short is indexed up to the last complete chunk and flagged with \c is_truncated.
+ */
+inline chunk_index scan_chunks(::std::span<const byte> bytes, const scan_options& options = scan_options())
+{
+	chunk_index index;
+	index.info = probe(bytes);
+
+	chunk_range range(bytes);
+	auto it{range.begin()};
+	for (; it != range.end(); ++it)
+	{
+		const chunk_view& chunk{*it};
+		index.chunks.push_back({chunk, !options.verify_crc || chunk.check_crc()});
+
+		switch (chunk.type)
+		{
+		case chunk_type_IDAT:
+			if (index.idat_runs.empty() || index.chunks[index.chunks.size() - 2].chunk.type != chunk_type_IDAT)
+			{
+				index.idat_runs.push_back({index.chunks.size() - 1, 0, chunk.offset, 0, 0});
+			}
+			++index.idat_runs.back().count;
+			index.idat_runs.back().end = chunk.offset + chunk.get_size();
+			index.idat_runs.back().data_size += chunk.data.size();
+			break;
+
+		case chunk_type_pHYs:
+			if (chunk.data.size() == 9)
+			{
+				index.phys = physical_dimensions{load_be32(chunk.data.data()), load_be32(chunk.data.data() + 4), chunk.data[8]};
+			}
+			break;
+
+		case chunk_type_tEXt:
+		{
+			auto [keyword, text]{detail::split_keyword(chunk.data)};
+			index.texts.push_back({keyword, detail::as_text(text)});
+			break;
+		}
+
+		case chunk_type_iTXt:
+		{
+			// keyword\0 compression_flag compression_method language\0 translated_keyword\0 text
+			auto [keyword, rest]{detail::split_keyword(chunk.data)};
+			if (rest.size() >= 2 && rest[0] == 0)
+			{
+				auto [language, rest2]{detail::split_keyword(rest.subspan(2))};
+				auto [translated, text]{detail::split_keyword(rest2)};
+				index.texts.push_back({keyword, detail::as_text(text)});
+			}
+			break;
+		}
+
+		case chunk_type_iCCP:
+		{
+			auto [name, rest]{detail::split_keyword(chunk.data)};
+			if (!rest.empty())
+			{
+				index.iccp = iccp_header{name, rest[0], rest.subspan(1)};
+			}
+			break;
+		}
+
+		case chunk_type_eXIf:
+			index.exif = chunk.data;
+			break;
+
+		case chunk_type_IEND:
+			index.has_iend = true;
+			break;
+
+		default:
+			break;
+		}
+	}
+	index.is_truncated = it.is_truncated();
+
+	return index;
+}
+
+} // namespace png
+
+#endif // PNGPP_CHUNK_SCANNER_HPP_INCLUDED
@@ -224,6 +224,29 @@ constexpr const bool png_read_interlacing_supported{false};
 	static inline constexpr const bool png_write_interlacing_supported{false};
 #endif
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define PNGPP_SSE2_SUPPORTED
+	static inline constexpr const bool sse2_supported{true};
+#else
+	static inline constexpr const bool sse2_supported{false};
+#endif
+
+#if defined(__AVX2__)
+	#define PNGPP_AVX2_SUPPORTED
+	static inline constexpr const bool avx2_supported{true};
+#else
+	static inline constexpr const bool avx2_supported{false};
+#endif
+
+// kernels for instruction sets beyond the compiler flags, picked at run time by the CPU features (see checksum.hpp)
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+	#define PNGPP_CPU_DISPATCH_SUPPORTED
+	#define PNGPP_TARGET(features) __attribute__((target(features)))
+#elif defined(_M_X64)
+	#define PNGPP_CPU_DISPATCH_SUPPORTED
+	#define PNGPP_TARGET(features)
+#endif
+
 static inline constexpr const bool __little_endian{
 	[](){
 		constexpr const uint16_t bytes{255u}; // fill one byte with 1's, the other byte with zero's
@@ -34,6 +34,9 @@
 #pragma once
 
 //#include <cassert>
+#include <algorithm>
+#include <array>
+#include <limits>
 #include <stdexcept>
 #include <iostream>
 #include <istream>
@@ -42,6 +45,7 @@
 #include "error.hpp"
 #include "streaming_base.hpp"
 #include "reader.hpp"
+#include "span_istream.hpp"
 #include "pixel_buffer.hpp"
 
 namespace png
@@ -77,6 +81,13 @@ namespace png
  * avaiable as the only parameter of the method. For non-interlaced images the method is called once prior to any calls to \c get_next_row().
  * The value of \c 0 is passed for the \c pass number.
  *
+ * A %consumer may also implement \c get_next_rows(), see row_band_provider. Rows are then read row_band_size at a time with
+ * reader::read_rows(), which saves the fixed per-row cost on tall narrow images. Implement it only if the row addresses can be handed out
+ * before the rows are read.
+ *
+ * A %consumer whose rows all live in memory may instead implement \c get_row_pointers(), see row_pointers_provider; it is called after
+ * \c reset(0) and the whole image is read with reader::read_image().
+ *
  * An optional template parameter \c info_holder encapsulates image_info storage policy. Using def_image_info_holder results in image_info object
  * stored as a sub-object of the consumer class. You may specify image_info_ref_holder in order to use a reference to the externally stored
  * image_info object. This way you will have to construct the consumer object passing the reference to image_info object.
@@ -135,13 +146,167 @@ public:
 	 * \brief Reads an image from the stream using custom io transformation.
 	 *
 	 * Essentially, this method constructs a reader object and instructs it to read the image from the stream.
-	 * It handles IO transformation, as well as interlaced image reading.
+	 * It handles IO transformation, as well as interlaced image reading. \a options selects the integrity checks, see decode_options.
 	 */
-	template<typename istream, typename transformation>
-	inline constexpr void read(istream& stream, const transformation& transform = transform_identity())
+	template<input_stream istream, typename transformation>
+	inline constexpr void read(istream& stream, const transformation& transform = transform_identity(),
+		const decode_options& options = decode_options())
 	{
 		reader<istream> rd(stream);
-		rd.read_info();
+		size_t pass_count{prepare(rd, transform, options)};
+
+		auto pixel_con{static_cast<pixcon*>(this)};
+		read_rows(rd, pass_count, pixel_con);
+
+		rd.read_end_info();
+	}
+
+	/**
+	 * \brief A read of one image that is advanced a number of rows at a time. Returned by begin_read().
+	 *
+	 * Lets a single threaded caller (an event loop, for instance) interleave a large decode with other work:
+	 *
+	 * \code
+	 * auto job{pixcon.begin_read(stream)};
+	 * while (job.step(64))
+	 * {
+	 *		// serve other requests
+	 * }
+	 * \endcode
+	 *
+	 * The reader, and therefore the stream, stay in use until the read is done. The object is neither copyable nor movable.
+	 */
+	template<input_stream istream>
+	class incremental_read
+	{
+	private:
+		incremental_read() = delete;
+
+		incremental_read(const incremental_read&) = delete;
+		incremental_read(incremental_read&&) = delete;
+
+		incremental_read& operator=(const incremental_read&) = delete;
+		incremental_read& operator=(incremental_read&&) = delete;
+
+	public:
+		/**
+		 * \brief Reads the image info and sets up the transformation; no rows are read yet.
+		 */
+		template<typename transformation>
+		inline incremental_read(consumer& con, istream& stream, const transformation& transform, const decode_options& options)
+			: m_consumer(con), m_reader(stream), m_pass_count(con.prepare(m_reader, transform, options)) {}
+
+		inline ~incremental_read() noexcept = default;
+
+		/**
+		 * \brief Reads up to \a max_rows more rows, followed by the end info once the last row is in.
+		 *
+		 * \return \c true while there are rows left to read.
+		 */
+		inline bool step(size_t max_rows)
+		{
+			auto pixel_con{static_cast<pixcon*>(&m_consumer)};
+			const uint32_t height{m_consumer.get_info().get_height()};
+
+			for (size_t count{0}; count < max_rows && m_pass < m_pass_count; ++count)
+			{
+				if (m_pos == 0)
+				{
+					pixel_con->reset(m_pass);
+				}
+
+				m_reader.read_row(pixel_con->get_next_row(m_pos));
+
+				if (++m_pos == height)
+				{
+					m_pos = 0;
+					++m_pass;
+				}
+			}
+
+			if (m_pass == m_pass_count && !m_done)
+			{
+				m_reader.read_end_info();
+				m_done = true;
+			}
+			return !m_done;
+		}
+
+		/**
+		 * \brief Reads all of the remaining rows.
+		 */
+		inline void finish()
+		{
+			while (step(::std::numeric_limits<size_t>::max()))
+			{
+			}
+		}
+
+		inline constexpr bool done() const noexcept
+		{
+			return m_done;
+		}
+
+		/**
+		 * \brief Returns the number of the interlace pass being read.
+		 */
+		inline constexpr size_t get_pass() const noexcept
+		{
+			return m_pass;
+		}
+
+		/**
+		 * \brief Returns the position of the next row to be read within the current pass.
+		 */
+		inline constexpr uint32_t get_position() const noexcept
+		{
+			return m_pos;
+		}
+
+	private:
+		consumer& m_consumer;
+		reader<istream> m_reader;
+		size_t m_pass_count;
+		size_t m_pass{0};
+		uint32_t m_pos{0};
+		bool m_done{false};
+	};
+
+	/**
+	 * \brief Starts a resumable read of an image from the stream using custom io transformation.
+	 *
+	 * Reads the image info right away; the rows are read by calling incremental_read::step().
+	 */
+	template<input_stream istream, typename transformation = transform_identity>
+	inline incremental_read<istream> begin_read(istream& stream, const transformation& transform = transform_identity(),
+		const decode_options& options = decode_options())
+	{
+		return incremental_read<istream>(*this, stream, transform, options);
+	}
+
+	/**
+	 * \brief Reads an image straight out of a memory buffer using custom io transformation.
+	 *
+	 * The bytes are handed to libpng directly from \a bytes; no stream object or intermediate copy of the buffer is made.
+	 */
+	template<typename transformation = transform_identity>
+	inline constexpr void read(::std::span<const byte> bytes, const transformation& transform = transform_identity(),
+		const decode_options& options = decode_options())
+	{
+		span_istream stream(bytes);
+		read(stream, transform, options);
+	}
+
+private:
+	/**
+	 * \brief Reads the image info and sets up the io transformation, byte swapping and interlace handling.
+	 *
+	 * \return the number of passes left to read.
+	 */
+	template<typename istream, typename transformation>
+	inline constexpr size_t prepare(reader<istream>& rd, const transformation& transform, const decode_options& options)
+	{
+		rd.read_info(options);
 		transform(rd);
 
 		if constexpr (__little_endian)
@@ -185,20 +350,16 @@ public:
 
 		this->get_info() = rd.get_image_info();
 
-		auto pixel_con{static_cast<pixcon*>(this)};
 		if (pass_count > 1 && !interlacing_supported)
 		{
 			skip_interlaced_rows(rd, pass_count);
 			pass_count = 1;
 		}
-		read_rows(rd, pass_count, pixel_con);
-
-		rd.read_end_info();
+		return pass_count;
 	}
 
-private:
 	template<typename istream>
-	inline constexpr void skip_interlaced_rows(reader<istream>& rd, size_t pass_count) noexcept
+	inline constexpr void skip_interlaced_rows(reader<istream>& rd, size_t pass_count)
 	{
 		using row = std::vector<pixel>;
 		using row_traits_type = row_traits<row>;
@@ -211,15 +372,41 @@ private:
 	}
 
 	template<typename istream>
-	inline constexpr void read_rows(reader<istream>& rd, size_t pass_count, pixcon* pixel_con) noexcept
+	inline constexpr void read_rows(reader<istream>& rd, size_t pass_count, pixcon* pixel_con)
 	{
+		const size_t height{this->get_info().get_height()};
+		if constexpr (row_pointers_provider<pixcon>)
+		{
+			// png_read_image() reads every pass itself, so only when prepare() left the passes to libpng
+			if (interlacing_supported || this->get_info().get_interlace_type() == interlace_none)
+			{
+				pixel_con->reset(0);
+				auto rows{pixel_con->get_row_pointers()};
+				rd.read_image(rows.data());
+				return;
+			}
+		}
+
 		for (size_t pass{0}; pass < pass_count; ++pass)
 		{
 			pixel_con->reset(pass);
 
-			for (uint32_t pos{0}; pos < this->get_info().get_height(); ++pos)
+			if constexpr (row_band_provider<pixcon>)
+			{
+				::std::array<byte*, row_band_size> rows;
+				for (size_t pos{0}; pos < height; pos += row_band_size)
+				{
+					const size_t count{::std::min(row_band_size, height - pos)};
+					pixel_con->get_next_rows(pos, count, rows.data());
+					rd.read_rows(rows.data(), count);
+				}
+			}
+			else
 			{
-				rd.read_row(pixel_con->get_next_row(pos));
+				for (uint32_t pos{0}; pos < height; ++pos)
+				{
+					rd.read_row(pixel_con->get_next_row(pos));
+				}
 			}
 		}
 	}
@@ -170,9 +170,9 @@ struct convert_color_space_impl
 	template<typename reader>
 	static inline constexpr void handle_alpha(reader& io, uint32_t filler) noexcept
 	{
-		bool src_alpha{(io.get_color_type() & color_mask_alpha)};
+		bool src_alpha{(io.get_color_type() & color_mask_alpha) != 0};
 		bool src_tRNS{io.has_chunk(chunk_tRNS)};
-		bool dst_alpha{traits::get_color_type() & color_mask_alpha};
+		bool dst_alpha{(traits::get_color_type() & color_mask_alpha) != 0};
 		if ((src_alpha || src_tRNS) && !dst_alpha)
 		{
 			if constexpr(png_read_strip_alpha_supported)
@@ -245,13 +245,21 @@ struct convert_color_space_impl
 	template<typename reader>
 	static inline constexpr void handle_rgb(reader& io) noexcept
 	{
-		bool src_rgb{io.get_color_type() & (color_mask_rgb | color_mask_palette)};
-		bool dst_rgb{traits::get_color_type() & color_mask_rgb};
+		bool src_rgb{(io.get_color_type() & (color_mask_rgb | color_mask_palette)) != 0};
+		bool dst_rgb{(traits::get_color_type() & color_mask_rgb) != 0};
 		if (src_rgb && !dst_rgb)
 		{
 			if constexpr (png_read_rgb_to_gray_supported)
 			{
-				io.set_rgb_to_gray(/*rgb_to_gray_error*/);
+				// the default weights, through whichever of the two overloads libpng was built for
+				if constexpr (png_floating_point_supported)
+				{
+					io.set_rgb_to_gray(rgb_to_gray_silent, -1.0, -1.0);
+				}
+				else
+				{
+					io.set_rgb_to_gray(rgb_to_gray_silent, fixed_point{-1}, fixed_point{-1});
+				}
 			}
 			else
 			{
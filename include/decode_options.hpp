@@ -0,0 +1,46 @@
+/**********************************************************************************************************************************************\
+	Copyright© 2021 Mason DeRoss
+
+	Released under either the GNU All-permissive License or MIT license. You pick.
+
+	Copying and distribution of this file, with or without modification, are permitted in any medium without royalty,
+	provided the copyright notice and this notice are preserved. This file is offered as-is, without any warranty.
+
+	DESCRIPTION:
+		Integrity checks the readers make, with a profile for trusted input that turns them off.
+
+\**********************************************************************************************************************************************/
+#ifndef PNGPP_DECODE_OPTIONS_HPP_INCLUDED
+#define PNGPP_DECODE_OPTIONS_HPP_INCLUDED
+
+#pragma once
+
+namespace png
+{
+
+/**
+ * \brief Which checks a read makes, see reader::read_info() and image::read().
+ *
+ * The defaults check everything, as libpng does. trusted() is for images whose integrity is already guaranteed, by the storage layer or
+ * by an end to end checksum: corrupt data then decodes to garbage, or fails later in zlib or the filters, instead of failing the CRC or
+ * Adler-32 check.
+ */
+struct decode_options
+{
+	bool verify_crc{true};						// chunk CRCs; libpng then uses the data of a chunk with a bad CRC as is
+	bool verify_adler{true};					// the Adler-32 at the end of the image data's zlib stream
+	bool check_profiles{true};					// whether an iCCP profile claiming to be sRGB is one of the known sRGB profiles
+
+	static inline constexpr decode_options trusted() noexcept
+	{
+		decode_options options;
+		options.verify_crc = false;
+		options.verify_adler = false;
+		options.check_profiles = false;
+		return options;
+	}
+};
+
+} // namespace png
+
+#endif // PNGPP_DECODE_OPTIONS_HPP_INCLUDED
@@ -0,0 +1,107 @@
+/**********************************************************************************************************************************************\
+	Copyright© 2021 Mason DeRoss
+
+	Released under either the GNU All-permissive License or MIT license. You pick.
+
+	Copying and distribution of this file, with or without modification, are permitted in any medium without royalty,
+	provided the copyright notice and this notice are preserved. This file is offered as-is, without any warranty.
+
+	DESCRIPTION:
+		Compression settings for the writer: zlib level, strategy, window and memory, IDAT size and row filters, with named presets.
+
+\**********************************************************************************************************************************************/
+#ifndef PNGPP_ENCODE_OPTIONS_HPP_INCLUDED
+#define PNGPP_ENCODE_OPTIONS_HPP_INCLUDED
+
+#pragma once
+
+#include <cstddef>
+
+extern "C"
+{
+	#include <png.h>
+	#include <zlib.h>
+}
+
+namespace png
+{
+
+/**
+ * \brief How a row filter is picked when more than one is allowed, see filter_chooser.
+ */
+enum filter_heuristic
+{
+	filter_heuristic_default,		// leave it to libpng, which minimizes the sum of absolute differences
+	filter_heuristic_min_sad,		// the lowest sum of the filtered bytes taken as signed values
+	filter_heuristic_entropy,		// the lowest estimated entropy of the filtered bytes
+	filter_heuristic_sticky			// like min_sad, but keep the previous row's filter unless another one saves more than sticky_gain
+};
+
+/**
+ * \brief How the writer compresses the image data, see writer::set_encode_options().
+ *
+ * With a \c heuristic other than filter_heuristic_default the generator picks the filter of every row itself, among \c filters, and
+ * hands libpng one filter per row; interlaced images are still left to libpng.
+ *
+ * The defaults are libpng's own, so a default constructed object changes nothing. The presets are points on the speed/size curve:
+ *
+ * - fastest(): zlib level 1 and the Up filter only, for responses that must go out now;
+ * - balanced(): level 6 and libpng's filters, the defaults, but with 64K IDAT chunks;
+ * - smallest(): level 9 and libpng's filters with the most zlib memory, for archival output;
+ * - low_memory(): a 4K zlib window, little zlib memory, 4K IDAT chunks and no filtering, so libpng keeps no previous row or filter
+ *   buffers. A writer then holds about 35K plus a row, against about 300K with the defaults, see writer::get_memory_usage().
+ */
+struct encode_options
+{
+	static inline constexpr int default_strategy{-1};
+
+	int level{Z_DEFAULT_COMPRESSION};			// 0 to 9, or Z_DEFAULT_COMPRESSION
+	int strategy{default_strategy};				// Z_FILTERED, Z_RLE, Z_HUFFMAN_ONLY, ...; by default Z_FILTERED when rows are filtered
+	int window_bits{15};						// 8 to 15; libpng shrinks the window further for small images
+	int mem_level{8};							// 1 to 9
+	size_t idat_size{8192};						// zlib output buffer, and so the size of the IDAT chunks
+	int filters{0};								// PNG_FILTER_NONE, PNG_FILTER_SUB, ... or'ed together, libpng picks one per row;
+												// 0 for libpng's choice: None for palette and sub-byte images, all five otherwise
+	filter_heuristic heuristic{filter_heuristic_default};	// anything else picks the filter of each row with a filter_chooser
+	int sticky_gain{10};						// filter_heuristic_sticky: percent of the previous filter's cost a new filter must save
+
+	static inline constexpr encode_options fastest() noexcept
+	{
+		encode_options options;
+		options.level = 1;
+		options.filters = PNG_FILTER_UP;
+		options.idat_size = 1 << 16;
+		return options;
+	}
+
+	static inline constexpr encode_options balanced() noexcept
+	{
+		encode_options options;
+		options.level = 6;
+		options.idat_size = 1 << 16;
+		return options;
+	}
+
+	static inline constexpr encode_options smallest() noexcept
+	{
+		encode_options options;
+		options.level = 9;
+		options.mem_level = 9;
+		options.idat_size = 1 << 16;
+		return options;
+	}
+
+	static inline constexpr encode_options low_memory() noexcept
+	{
+		encode_options options;
+		options.window_bits = 12;
+		options.mem_level = 2;
+		options.idat_size = 4096;
+		options.filters = PNG_FILTER_NONE;
+		return options;
+	}
+};
+
+} // namespace png
+
+#endif // PNGPP_ENCODE_OPTIONS_HPP_INCLUDED
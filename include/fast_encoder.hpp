@@ -0,0 +1,455 @@
+/**********************************************************************************************************************************************\
+	Copyright© 2021 Mason DeRoss
+
+	Released under either the GNU All-permissive License or MIT license. You pick.
+
+	Copying and distribution of this file, with or without modification, are permitted in any medium without royalty,
+	provided the copyright notice and this notice are preserved. This file is offered as-is, without any warranty.
+
+	DESCRIPTION:
+		A throughput-first PNG encoder for 8-bit images: one fixed filter and a single-probe LZ77 coded with the fixed Huffman tables.
+
+\**********************************************************************************************************************************************/
+#ifndef PNGPP_FAST_ENCODER_HPP_INCLUDED
+#define PNGPP_FAST_ENCODER_HPP_INCLUDED
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <span>
+#include <vector>
+
+extern "C"
+{
+	#include <zlib.h>
+}
+
+#include "config.hpp"
+#include "types.hpp"
+#include "error.hpp"
+#include "image_info.hpp"
+#include "chunk.hpp"
+#include "checksum.hpp"
+#include "filter.hpp"
+#include "writer.hpp"
+
+namespace png
+{
+
+/**
+ * \brief How image::write() encodes the image data.
+ */
+enum encode_mode
+{
+	encode_mode_default,				// libpng and zlib with the writer's settings
+	encode_mode_fast					// fast_encoder when the format allows it: much faster, somewhat larger files
+};
+
+namespace detail
+{
+
+/**
+ * \brief A deflate code, bit-reversed as it is written LSB first, with its extra bits already appended.
+ */
+struct fixed_code
+{
+	uint32_t bits{0};
+	uint32_t count{0};
+};
+
+inline constexpr uint32_t reverse_bits(uint32_t code, uint32_t count) noexcept
+{
+	uint32_t reversed{0};
+	for (uint32_t i{0}; i < count; ++i, code >>= 1)
+	{
+		reversed = (reversed << 1) | (code & 1);
+	}
+	return reversed;
+}
+
+/**
+ * \brief The code of literal/length symbol \a symbol in the fixed Huffman table of RFC 1951, 3.2.6.
+ */
+inline constexpr fixed_code fixed_literal_code(uint32_t symbol) noexcept
+{
+	if (symbol < 144)
+	{
+		return {reverse_bits(0x30 + symbol, 8), 8};
+	}
+	if (symbol < 256)
+	{
+		return {reverse_bits(0x190 + symbol - 144, 9), 9};
+	}
+	if (symbol < 280)
+	{
+		return {reverse_bits(symbol - 256, 7), 7};
+	}
+	return {reverse_bits(0xc0 + symbol - 280, 8), 8};
+}
+
+inline constexpr ::std::array<fixed_code, 256> make_fixed_literal_codes() noexcept
+{
+	::std::array<fixed_code, 256> codes;
+	for (uint32_t i{0}; i < 256; ++i)
+	{
+		codes[i] = fixed_literal_code(i);
+	}
+	return codes;
+}
+
+/**
+ * \brief The codes of match lengths 3 to 258, symbol and extra bits.
+ */
+inline constexpr ::std::array<fixed_code, 259> make_fixed_length_codes() noexcept
+{
+	::std::array<fixed_code, 259> codes;
+	for (uint32_t length{3}; length <= 258; ++length)
+	{
+		const uint32_t value{length - 3};
+		uint32_t symbol{257 + value};
+		uint32_t extra_bits{0};
+		uint32_t extra{0};
+		if (length == 258)
+		{
+			symbol = 285;
+		}
+		else if (value >= 8)
+		{
+			const uint32_t n{static_cast<uint32_t>(::std::bit_width(value)) - 1};
+			extra_bits = n - 2;
+			symbol = 257 + 4 * (n - 1) + ((value >> extra_bits) & 3);
+			extra = value & ((1u << extra_bits) - 1);
+		}
+		const fixed_code code{fixed_literal_code(symbol)};
+		codes[length] = {code.bits | (extra << code.count), code.count + extra_bits};
+	}
+	return codes;
+}
+
+inline constexpr const ::std::array<fixed_code, 256> fixed_literal_codes{make_fixed_literal_codes()};
+inline constexpr const ::std::array<fixed_code, 259> fixed_length_codes{make_fixed_length_codes()};
+
+/**
+ * \brief The code of match distance \a distance (1 to 32768): 5-bit fixed code and extra bits.
+ */
+inline constexpr fixed_code fixed_distance_code(uint32_t distance) noexcept
+{
+	const uint32_t value{distance - 1};
+	if (value < 4)
+	{
+		return {reverse_bits(value, 5), 5};
+	}
+	const uint32_t n{static_cast<uint32_t>(::std::bit_width(value)) - 1};
+	const uint32_t extra_bits{n - 1};
+	const uint32_t code{2 * n + ((value >> extra_bits) & 1)};
+	return {reverse_bits(code, 5) | ((value & ((1u << extra_bits) - 1)) << 5), 5 + extra_bits};
+}
+
+/**
+ * \brief Collects a deflate bit stream, LSB first, in a byte buffer the caller drains with take().
+ */
+class bit_writer
+{
+public:
+	/**
+	 * \brief Makes room for \a bytes more output bytes; put() does not check.
+	 */
+	inline void reserve(size_t bytes)
+	{
+		if (m_bytes.size() < m_size + bytes + 8)
+		{
+			m_bytes.resize(m_size + bytes + 8);
+		}
+	}
+
+	/**
+	 * \brief Appends the low \a count bits of \a bits, \a count at most 32.
+	 *
+	 * All eight accumulator bytes are stored every time and the whole ones are kept, which needs no branch.
+	 */
+	inline void put(uint32_t bits, uint32_t count) noexcept
+	{
+		m_bits |= static_cast<uint64_t>(bits) << m_count;
+		m_count += count;
+		if constexpr (__little_endian)
+		{
+			::std::memcpy(m_bytes.data() + m_size, &m_bits, 8);
+		}
+		else
+		{
+			for (size_t i{0}; i < 8; ++i)
+			{
+				m_bytes[m_size + i] = static_cast<byte>(m_bits >> (8 * i));
+			}
+		}
+		m_size += m_count >> 3;
+		m_bits >>= m_count & ~7u;
+		m_count &= 7;
+	}
+
+	/**
+	 * \brief Pads the stream to a whole byte and moves the pending bits to the buffer.
+	 */
+	inline void finish() noexcept
+	{
+		if (m_count > 0)
+		{
+			m_bytes[m_size++] = static_cast<byte>(m_bits);
+		}
+		m_bits = 0;
+		m_count = 0;
+	}
+
+	/**
+	 * \brief Returns the complete bytes written so far and empties the buffer; pending bits stay.
+	 */
+	inline ::std::span<const byte> take() noexcept
+	{
+		const ::std::span<const byte> bytes(m_bytes.data(), m_size);
+		m_size = 0;
+		return bytes;
+	}
+
+private:
+	::std::vector<byte> m_bytes;
+	size_t m_size{0};
+	uint64_t m_bits{0};
+	uint32_t m_count{0};
+};
+
+} // namespace detail
+
+/**
+ * \brief Encodes 8-bit non-interlaced images for speed rather than size, fpng style.
+ *
+ * Every row is filtered with Up, and the filtered data is deflated by a greedy LZ77 that probes one hash table entry per position and codes
+ * the result with the fixed Huffman tables, so there is no tree to build or send. Runs of equal bytes, the bulk of Up-filtered data, come
+ * out as distance-1 matches. Rows are processed in batches of about 256 KiB, each one fixed Huffman block that may refer to the 32K of data
+ * in front of it. Any PNG decoder reads the output.
+ *
+ * \see image::write(), encode_mode
+ */
+class fast_encoder
+{
+public:
+	static inline constexpr size_t hash_bits{15};
+	static inline constexpr size_t window_size{32768};
+
+	/**
+	 * \brief Returns \c true for the images fast_encoder handles: 8-bit samples, not interlaced.
+	 */
+	static inline constexpr bool is_supported(const image_info& info) noexcept
+	{
+		return info.get_bit_depth() == 8 && info.get_interlace_type() == interlace_none;
+	}
+
+	explicit inline fast_encoder(const image_info& info) : m_info(info), m_rowbytes(info.get_rowbytes()), m_table(size_t{1} << hash_bits)
+	{
+		if (!is_supported(m_info))
+		{
+			throw error("fast_encoder: only 8-bit non-interlaced images are supported");
+		}
+	}
+
+	/**
+	 * \brief Produces the zlib stream holding the filtered image data.
+	 *
+	 * \a get_row(pos) returns the address of row \c pos, called in order; \a sink receives the stream as a sequence of
+	 * \c std::span<const \c byte>.
+	 */
+	template<typename row_source, typename byte_sink>
+	inline void encode(const row_source& get_row, const byte_sink& sink)
+	{
+		const size_t stride{m_rowbytes + 1};
+		const size_t height{m_info.get_height()};
+		const size_t batch_rows{::std::max<size_t>((256 << 10) / stride, 1)};
+
+		const ::std::array<byte, 2> header{0x78, 0x01};
+		sink(::std::span<const byte>(header));
+
+		::std::fill(m_table.begin(), m_table.end(), 0);
+		::std::vector<byte> zeros(m_rowbytes);
+		const byte* prev{zeros.data()};
+		uint32_t adler{1};						// the Adler-32 of no data
+		size_t history{0};
+
+		for (size_t first{0}; first < height; first += batch_rows)
+		{
+			const size_t last{::std::min(first + batch_rows, height)};
+			m_window.resize(history + (last - first) * stride);
+
+			byte* out{m_window.data() + history};
+			for (size_t pos{first}; pos < last; ++pos, out += stride)
+			{
+				const byte* row{reinterpret_cast<const byte*>(get_row(pos))};
+				out[0] = row_filter_up;
+				for (size_t i{0}; i < m_rowbytes; ++i)
+				{
+					out[i + 1] = static_cast<byte>(row[i] - prev[i]);
+				}
+				prev = row;
+			}
+
+			const size_t size{m_window.size() - history};
+			adler = adler32(::std::span(m_window).subspan(history, size), adler);
+			compress(history, last == height);
+			sink(m_bits.take());
+
+			history = slide();
+		}
+
+		::std::array<byte, 4> trailer;
+		store_be32(trailer.data(), adler);
+		sink(::std::span<const byte>(trailer));
+	}
+
+	/**
+	 * \brief Writes the complete PNG data stream to \a stream: the header chunks through libpng, then the IDAT chunks and IEND.
+	 */
+	template<typename ostream, typename row_source>
+	inline void write(ostream& stream, const row_source& get_row)
+	{
+		{
+			writer<ostream> wr(stream);
+			wr.set_image_info(m_info);
+			wr.write_info();
+		}
+
+		idat_writer<ostream> idat(stream);
+		encode(get_row, [&idat](::std::span<const byte> bytes){ idat.write(bytes); });
+		idat.flush();
+
+		write_chunk(stream, chunk_type_IEND, {});
+		stream.flush();
+	}
+
+private:
+	static inline uint32_t load32(const byte* bytes) noexcept
+	{
+		uint32_t value;
+		::std::memcpy(&value, bytes, 4);
+		return value;
+	}
+
+	static inline size_t hash_of(uint32_t value) noexcept
+	{
+		return (value * 2654435761u) >> (32 - hash_bits);
+	}
+
+	static inline size_t hash_at(const byte* bytes) noexcept
+	{
+		return hash_of(load32(bytes));
+	}
+
+	/**
+	 * \brief Returns how many bytes, at least 4 and at most \a limit, \a match and \a current have in common, comparing 8 at a time.
+	 */
+	static inline size_t match_length(const byte* match, const byte* current, size_t limit) noexcept
+	{
+		size_t length{4};
+		for (; length + 8 <= limit; length += 8)
+		{
+			uint64_t a, b;
+			::std::memcpy(&a, match + length, 8);
+			::std::memcpy(&b, current + length, 8);
+			if (a != b)
+			{
+				if constexpr (__little_endian)
+				{
+					return length + (::std::countr_zero(a ^ b) >> 3);
+				}
+				else
+				{
+					return length + (::std::countl_zero(a ^ b) >> 3);
+				}
+			}
+		}
+		while (length < limit && match[length] == current[length])
+		{
+			++length;
+		}
+		return length;
+	}
+
+	/**
+	 * \brief Codes the window from \a begin to its end as one fixed Huffman block.
+	 */
+	inline void compress(size_t begin, bool final)
+	{
+		const byte* data{m_window.data()};
+		const size_t end{m_window.size()};
+		m_bits.reserve((end - begin) * 9 / 8 + 16);
+		m_bits.put(final ? 3 : 2, 3);							// BFINAL, BTYPE 01
+
+		size_t i{begin};
+		while (i < end)
+		{
+			if (i + 4 <= end)
+			{
+				const uint32_t value{load32(data + i)};
+				const size_t hash{hash_of(value)};
+				const uint32_t candidate{m_table[hash]};
+				m_table[hash] = static_cast<uint32_t>(i + 1);
+
+				if (candidate != 0 && i + 1 - candidate <= window_size && load32(data + candidate - 1) == value)
+				{
+					const size_t length{match_length(data + candidate - 1, data + i, ::std::min<size_t>(258, end - i))};
+
+					const detail::fixed_code& length_code{detail::fixed_length_codes[length]};
+					const detail::fixed_code distance_code{detail::fixed_distance_code(static_cast<uint32_t>(i + 1 - candidate))};
+					m_bits.put(length_code.bits, length_code.count);
+					m_bits.put(distance_code.bits, distance_code.count);
+					i += length;
+					if (i + 2 <= end)
+					{
+						// seed the table with the last position of the match, cheap and it finds the next run sooner
+						m_table[hash_at(data + i - 2)] = static_cast<uint32_t>(i - 1);
+					}
+					continue;
+				}
+			}
+
+			const detail::fixed_code& literal{detail::fixed_literal_codes[data[i]]};
+			m_bits.put(literal.bits, literal.count);
+			++i;
+		}
+
+		m_bits.put(0, 7);										// end of block
+		if (final)
+		{
+			m_bits.finish();
+		}
+	}
+
+	/**
+	 * \brief Keeps the last window_size bytes of the window as history for the next batch and rebases the hash table on it.
+	 */
+	inline size_t slide()
+	{
+		const size_t keep{::std::min(m_window.size(), window_size)};
+		const size_t shift{m_window.size() - keep};
+		if (shift > 0)
+		{
+			::std::memmove(m_window.data(), m_window.data() + shift, keep);
+			m_window.resize(keep);
+			for (auto& entry : m_table)
+			{
+				entry = entry > shift ? static_cast<uint32_t>(entry - shift) : 0;
+			}
+		}
+		return keep;
+	}
+
+	image_info m_info;
+	size_t m_rowbytes;
+	::std::vector<uint32_t> m_table;					// position + 1 of the last 4 bytes with each hash, 0 if none
+	::std::vector<byte> m_window;						// history followed by the filtered rows of the current batch
+	detail::bit_writer m_bits;
+};
+
+} // namespace png
+
+#endif // PNGPP_FAST_ENCODER_HPP_INCLUDED
@@ -0,0 +1,393 @@
+/**********************************************************************************************************************************************\
+	Copyright© 2021 Mason DeRoss
+
+	Released under either the GNU All-permissive License or MIT license. You pick.
+
+	Copying and distribution of this file, with or without modification, are permitted in any medium without royalty,
+	provided the copyright notice and this notice are preserved. This file is offered as-is, without any warranty.
+
+	DESCRIPTION:
+		The five PNG row filters and their inverses, for encoders and decoders that bypass libpng's row pipeline.
+
+\**********************************************************************************************************************************************/
+#ifndef PNGPP_FILTER_HPP_INCLUDED
+#define PNGPP_FILTER_HPP_INCLUDED
+
+#pragma once
+
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+
+#include "config.hpp"
+#include "types.hpp"
+#include "error.hpp"
+#include "image_info.hpp"
+
+#if defined(PNGPP_SSE2_SUPPORTED)
+	#include <emmintrin.h>
+#endif
+#if defined(PNGPP_AVX2_SUPPORTED)
+	#include <immintrin.h>
+#endif
+
+namespace png
+{
+
+/**
+ * \brief The filter type byte in front of every row of filter method 0.
+ */
+enum row_filter
+{
+	row_filter_none = PNG_FILTER_VALUE_NONE,
+	row_filter_sub = PNG_FILTER_VALUE_SUB,
+	row_filter_up = PNG_FILTER_VALUE_UP,
+	row_filter_avg = PNG_FILTER_VALUE_AVG,
+	row_filter_paeth = PNG_FILTER_VALUE_PAETH
+};
+
+/**
+ * \brief Returns the distance in bytes between a byte and the corresponding byte of the pixel to its left, at least 1.
+ */
+inline constexpr size_t get_filter_bpp(const image_info& info) noexcept
+{
+	const size_t bits{static_cast<size_t>(info.get_channels()) * info.get_bit_depth()};
+	return bits < 8 ? 1 : bits / 8;
+}
+
+namespace detail
+{
+
+inline constexpr byte paeth_predictor(int a, int b, int c) noexcept
+{
+	const int p{a + b - c};
+	const int pa{::std::abs(p - a)};
+	const int pb{::std::abs(p - b)};
+	const int pc{::std::abs(p - c)};
+	if (pa <= pb && pa <= pc)
+	{
+		return static_cast<byte>(a);
+	}
+	return static_cast<byte>(pb <= pc ? b : c);
+}
+
+/**
+ * \brief Filters \a rowbytes bytes of \a row into \a out. \a prev is the previous unfiltered row, all zeros for the first row.
+ */
+inline void filter_row(row_filter filter, const byte* row, const byte* prev, byte* out, size_t rowbytes, size_t bpp) noexcept
+{
+	switch (filter)
+	{
+	case row_filter_none:
+		::std::memcpy(out, row, rowbytes);
+		break;
+
+	case row_filter_sub:
+		for (size_t i{0}; i < rowbytes; ++i)
+		{
+			out[i] = static_cast<byte>(row[i] - (i >= bpp ? row[i - bpp] : 0));
+		}
+		break;
+
+	case row_filter_up:
+		for (size_t i{0}; i < rowbytes; ++i)
+		{
+			out[i] = static_cast<byte>(row[i] - prev[i]);
+		}
+		break;
+
+	case row_filter_avg:
+		for (size_t i{0}; i < rowbytes; ++i)
+		{
+			const int left{i >= bpp ? row[i - bpp] : 0};
+			out[i] = static_cast<byte>(row[i] - ((left + prev[i]) >> 1));
+		}
+		break;
+
+	case row_filter_paeth:
+		for (size_t i{0}; i < rowbytes; ++i)
+		{
+			const int left{i >= bpp ? row[i - bpp] : 0};
+			const int upper_left{i >= bpp ? prev[i - bpp] : 0};
+			out[i] = static_cast<byte>(row[i] - paeth_predictor(left, prev[i], upper_left));
+		}
+		break;
+	}
+}
+
+/**
+ * \brief Reverses filter_row() in place. \a prev is the previous reconstructed row, all zeros for the first row.
+ *
+ * Throws png::error for an unknown filter type.
+ */
+inline void unfilter_row(int filter, byte* row, const byte* prev, size_t rowbytes, size_t bpp)
+{
+	switch (filter)
+	{
+	case row_filter_none:
+		break;
+
+	case row_filter_sub:
+		for (size_t i{bpp}; i < rowbytes; ++i)
+		{
+			row[i] = static_cast<byte>(row[i] + row[i - bpp]);
+		}
+		break;
+
+	case row_filter_up:
+		for (size_t i{0}; i < rowbytes; ++i)
+		{
+			row[i] = static_cast<byte>(row[i] + prev[i]);
+		}
+		break;
+
+	case row_filter_avg:
+		for (size_t i{0}; i < rowbytes; ++i)
+		{
+			const int left{i >= bpp ? row[i - bpp] : 0};
+			row[i] = static_cast<byte>(row[i] + ((left + prev[i]) >> 1));
+		}
+		break;
+
+	case row_filter_paeth:
+		for (size_t i{0}; i < rowbytes; ++i)
+		{
+			const int left{i >= bpp ? row[i - bpp] : 0};
+			const int upper_left{i >= bpp ? prev[i - bpp] : 0};
+			row[i] = static_cast<byte>(row[i] + paeth_predictor(left, prev[i], upper_left));
+		}
+		break;
+
+	default:
+		throw error("unfilter_row: unknown filter type");
+	}
+}
+
+#if defined(PNGPP_SSE2_SUPPORTED)
+
+/**
+ * \brief SSE2 versions of the Sub, Avg and Paeth reconstruction for 3 and 4 bytes per pixel, after libpng's filter_sse2_intrinsics.c.
+ *
+ * These filters depend on the pixel to the left, so one pixel is reconstructed at a time, all its channels at once.
+ */
+namespace sse2
+{
+
+template<size_t bpp>
+inline __m128i load(const byte* p) noexcept
+{
+	int32_t value{0};
+	::std::memcpy(&value, p, bpp);
+	return _mm_cvtsi32_si128(value);
+}
+
+template<size_t bpp>
+inline void store(byte* p, __m128i v) noexcept
+{
+	const int32_t value{_mm_cvtsi128_si32(v)};
+	::std::memcpy(p, &value, bpp);
+}
+
+template<size_t bpp>
+inline void unfilter_sub(byte* row, size_t rowbytes) noexcept
+{
+	__m128i a{_mm_setzero_si128()};
+	for (size_t i{0}; i < rowbytes; i += bpp)
+	{
+		a = _mm_add_epi8(a, load<bpp>(row + i));
+		store<bpp>(row + i, a);
+	}
+}
+
+template<size_t bpp>
+inline void unfilter_avg(byte* row, const byte* prev, size_t rowbytes) noexcept
+{
+	const __m128i one{_mm_set1_epi8(1)};
+	__m128i a{_mm_setzero_si128()};
+	for (size_t i{0}; i < rowbytes; i += bpp)
+	{
+		const __m128i b{load<bpp>(prev + i)};
+		// _mm_avg_epu8 rounds up, the filter rounds down
+		const __m128i avg{_mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one))};
+		a = _mm_add_epi8(load<bpp>(row + i), avg);
+		store<bpp>(row + i, a);
+	}
+}
+
+inline __m128i abs_i16(__m128i x) noexcept
+{
+	const __m128i negative{_mm_cmplt_epi16(x, _mm_setzero_si128())};
+	return _mm_add_epi16(_mm_xor_si128(x, negative), _mm_srli_epi16(negative, 15));
+}
+
+inline __m128i select(__m128i condition, __m128i then, __m128i otherwise) noexcept
+{
+	return _mm_or_si128(_mm_and_si128(condition, then), _mm_andnot_si128(condition, otherwise));
+}
+
+template<size_t bpp>
+inline void unfilter_paeth(byte* row, const byte* prev, size_t rowbytes) noexcept
+{
+	const __m128i zero{_mm_setzero_si128()};
+	__m128i b{zero};
+	__m128i d{zero};
+	for (size_t i{0}; i < rowbytes; i += bpp)
+	{
+		// a: left, b: above, c: upper left, each widened to 16 bits
+		const __m128i c{b};
+		b = _mm_unpacklo_epi8(load<bpp>(prev + i), zero);
+		const __m128i a{d};
+		d = _mm_unpacklo_epi8(load<bpp>(row + i), zero);
+
+		__m128i pa{_mm_sub_epi16(b, c)};
+		__m128i pb{_mm_sub_epi16(a, c)};
+		__m128i pc{_mm_add_epi16(pa, pb)};
+		pa = abs_i16(pa);
+		pb = abs_i16(pb);
+		pc = abs_i16(pc);
+
+		const __m128i smallest{_mm_min_epi16(pc, _mm_min_epi16(pa, pb))};
+		const __m128i nearest{select(_mm_cmpeq_epi16(smallest, pa), a, select(_mm_cmpeq_epi16(smallest, pb), b, c))};
+		d = _mm_add_epi8(d, nearest);
+		store<bpp>(row + i, _mm_packus_epi16(d, d));
+	}
+}
+
+} // namespace sse2
+
+#endif
+
+/**
+ * \brief Up reconstruction, which has no dependency between bytes, 32 or 16 bytes at a time where available.
+ */
+inline void unfilter_up(byte* row, const byte* prev, size_t rowbytes) noexcept
+{
+	size_t i{0};
+#if defined(PNGPP_AVX2_SUPPORTED)
+	for (; i + 32 <= rowbytes; i += 32)
+	{
+		const __m256i x{_mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + i))};
+		const __m256i b{_mm256_loadu_si256(reinterpret_cast<const __m256i*>(prev + i))};
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(row + i), _mm256_add_epi8(x, b));
+	}
+#endif
+#if defined(PNGPP_SSE2_SUPPORTED)
+	for (; i + 16 <= rowbytes; i += 16)
+	{
+		const __m128i x{_mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i))};
+		const __m128i b{_mm_loadu_si128(reinterpret_cast<const __m128i*>(prev + i))};
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(row + i), _mm_add_epi8(x, b));
+	}
+#endif
+	for (; i < rowbytes; ++i)
+	{
+		row[i] = static_cast<byte>(row[i] + prev[i]);
+	}
+}
+
+/**
+ * \brief unfilter_row() using the SIMD kernels where they apply: Up for every format, Sub, Avg and Paeth for 3 and 4 bytes per pixel.
+ */
+inline void unfilter_row_fast(int filter, byte* row, const byte* prev, size_t rowbytes, size_t bpp)
+{
+	if (filter == row_filter_up)
+	{
+		unfilter_up(row, prev, rowbytes);
+		return;
+	}
+#if defined(PNGPP_SSE2_SUPPORTED)
+	if (bpp == 3 || bpp == 4)
+	{
+		switch (filter)
+		{
+		case row_filter_sub:
+			bpp == 3 ? sse2::unfilter_sub<3>(row, rowbytes) : sse2::unfilter_sub<4>(row, rowbytes);
+			return;
+		case row_filter_avg:
+			bpp == 3 ? sse2::unfilter_avg<3>(row, prev, rowbytes) : sse2::unfilter_avg<4>(row, prev, rowbytes);
+			return;
+		case row_filter_paeth:
+			bpp == 3 ? sse2::unfilter_paeth<3>(row, prev, rowbytes) : sse2::unfilter_paeth<4>(row, prev, rowbytes);
+			return;
+		default:
+			break;
+		}
+	}
+#endif
+	unfilter_row(filter, row, prev, rowbytes, bpp);
+}
+
+/**
+ * \brief unfilter_row() for the first row, whose previous row is all zeros, without a row of zeros to read: Up then changes nothing
+ * and Paeth always predicts the left byte, as Sub does.
+ */
+inline void unfilter_first_row(int filter, byte* row, size_t rowbytes, size_t bpp)
+{
+	switch (filter)
+	{
+	case row_filter_none:
+	case row_filter_up:
+		break;
+
+	case row_filter_sub:
+	case row_filter_paeth:
+		unfilter_row(row_filter_sub, row, nullptr, rowbytes, bpp);
+		break;
+
+	case row_filter_avg:
+		for (size_t i{bpp}; i < rowbytes; ++i)
+		{
+			row[i] = static_cast<byte>(row[i] + (row[i - bpp] >> 1));
+		}
+		break;
+
+	default:
+		throw error("unfilter_first_row: unknown filter type");
+	}
+}
+
+/**
+ * \brief The sum of the filtered bytes taken as signed values, libpng's measure of how well a row will compress.
+ */
+inline uint64_t filter_cost(const byte* filtered, size_t rowbytes) noexcept
+{
+	// min(x, -x) as unsigned bytes is the magnitude of x as a signed byte, 128 for 0x80
+	uint64_t sum{0};
+	size_t i{0};
+#if defined(PNGPP_AVX2_SUPPORTED)
+	__m256i sums{_mm256_setzero_si256()};
+	for (; i + 32 <= rowbytes; i += 32)
+	{
+		const __m256i x{_mm256_loadu_si256(reinterpret_cast<const __m256i*>(filtered + i))};
+		const __m256i magnitude{_mm256_min_epu8(x, _mm256_sub_epi8(_mm256_setzero_si256(), x))};
+		sums = _mm256_add_epi64(sums, _mm256_sad_epu8(magnitude, _mm256_setzero_si256()));
+	}
+	alignas(32) ::std::array<uint64_t, 4> lanes;
+	_mm256_store_si256(reinterpret_cast<__m256i*>(lanes.data()), sums);
+	sum += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+#if defined(PNGPP_SSE2_SUPPORTED)
+	__m128i partial{_mm_setzero_si128()};
+	for (; i + 16 <= rowbytes; i += 16)
+	{
+		const __m128i x{_mm_loadu_si128(reinterpret_cast<const __m128i*>(filtered + i))};
+		const __m128i magnitude{_mm_min_epu8(x, _mm_sub_epi8(_mm_setzero_si128(), x))};
+		partial = _mm_add_epi64(partial, _mm_sad_epu8(magnitude, _mm_setzero_si128()));
+	}
+	alignas(16) ::std::array<uint64_t, 2> halves;
+	_mm_store_si128(reinterpret_cast<__m128i*>(halves.data()), partial);
+	sum += halves[0] + halves[1];
+#endif
+	for (; i < rowbytes; ++i)
+	{
+		sum += filtered[i] < 128 ? filtered[i] : 256 - filtered[i];
+	}
+	return sum;
+}
+
+} // namespace detail
+
+} // namespace png
+
+#endif // PNGPP_FILTER_HPP_INCLUDED
@@ -0,0 +1,314 @@
+/**********************************************************************************************************************************************\
+	Copyright© 2021 Mason DeRoss
+
+	Released under either the GNU All-permissive License or MIT license. You pick.
+
+	Copying and distribution of this file, with or without modification, are permitted in any medium without royalty,
+	provided the copyright notice and this notice are preserved. This file is offered as-is, without any warranty.
+
+	DESCRIPTION:
+		Per-row filter selection for the encoders: every allowed filter is tried on the row and one is kept by a configurable heuristic.
+
+\**********************************************************************************************************************************************/
+#ifndef PNGPP_FILTER_CHOOSER_HPP_INCLUDED
+#define PNGPP_FILTER_CHOOSER_HPP_INCLUDED
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "config.hpp"
+#include "types.hpp"
+#include "image_info.hpp"
+#include "filter.hpp"
+#include "encode_options.hpp"
+
+#if defined(PNGPP_AVX2_SUPPORTED)
+	#include <immintrin.h>
+#endif
+
+namespace png
+{
+
+namespace detail
+{
+
+#if defined(PNGPP_AVX2_SUPPORTED)
+
+namespace avx2
+{
+
+inline __m256i load(const byte* p) noexcept
+{
+	return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+}
+
+inline void store(byte* p, __m256i v) noexcept
+{
+	_mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v);
+}
+
+/**
+ * \brief The Paeth predictor of 16 pixels' worth of bytes widened to 16 bits: a is left, b above and c upper left.
+ */
+inline __m256i paeth_predictor(__m256i a, __m256i b, __m256i c) noexcept
+{
+	const __m256i bc{_mm256_sub_epi16(b, c)};
+	const __m256i ac{_mm256_sub_epi16(a, c)};
+	const __m256i pa{_mm256_abs_epi16(bc)};
+	const __m256i pb{_mm256_abs_epi16(ac)};
+	const __m256i pc{_mm256_abs_epi16(_mm256_add_epi16(bc, ac))};
+	const __m256i b_or_c{_mm256_blendv_epi8(b, c, _mm256_cmpgt_epi16(pb, pc))};
+	return _mm256_blendv_epi8(a, b_or_c, _mm256_or_si256(_mm256_cmpgt_epi16(pa, pb), _mm256_cmpgt_epi16(pa, pc)));
+}
+
+} // namespace avx2
+
+#endif
+
+/**
+ * \brief Filters \a row with Sub, Up, Avg and Paeth at once into \a out, four consecutive runs of \a rowbytes bytes.
+ *
+ * Unlike the reconstruction, filtering only reads unfiltered bytes, so with AVX2 32 bytes of every filter are produced per step whatever
+ * the pixel size.
+ */
+inline void filter_candidates(const byte* row, const byte* prev, byte* out, size_t rowbytes, size_t bpp) noexcept
+{
+	byte* sub{out};
+	byte* up{out + rowbytes};
+	byte* avg{out + 2 * rowbytes};
+	byte* paeth{out + 3 * rowbytes};
+
+	// no pixel to the left: Sub is None and Paeth is Up
+	size_t i{0};
+	for (; i < ::std::min(bpp, rowbytes); ++i)
+	{
+		sub[i] = row[i];
+		up[i] = static_cast<byte>(row[i] - prev[i]);
+		avg[i] = static_cast<byte>(row[i] - (prev[i] >> 1));
+		paeth[i] = up[i];
+	}
+
+#if defined(PNGPP_AVX2_SUPPORTED)
+	const __m256i zero{_mm256_setzero_si256()};
+	const __m256i one{_mm256_set1_epi8(1)};
+	for (; i + 32 <= rowbytes; i += 32)
+	{
+		const __m256i x{avx2::load(row + i)};
+		const __m256i a{avx2::load(row + i - bpp)};
+		const __m256i b{avx2::load(prev + i)};
+		const __m256i c{avx2::load(prev + i - bpp)};
+
+		avx2::store(sub + i, _mm256_sub_epi8(x, a));
+		avx2::store(up + i, _mm256_sub_epi8(x, b));
+		// _mm256_avg_epu8 rounds up, the filter rounds down
+		avx2::store(avg + i, _mm256_sub_epi8(x, _mm256_sub_epi8(_mm256_avg_epu8(a, b), _mm256_and_si256(_mm256_xor_si256(a, b), one))));
+
+		// the unpacks and the pack work within 128-bit lanes, so the bytes come back in order
+		const __m256i low{avx2::paeth_predictor(_mm256_unpacklo_epi8(a, zero), _mm256_unpacklo_epi8(b, zero), _mm256_unpacklo_epi8(c, zero))};
+		const __m256i high{avx2::paeth_predictor(_mm256_unpackhi_epi8(a, zero), _mm256_unpackhi_epi8(b, zero), _mm256_unpackhi_epi8(c, zero))};
+		avx2::store(paeth + i, _mm256_sub_epi8(x, _mm256_packus_epi16(low, high)));
+	}
+#endif
+
+	for (; i < rowbytes; ++i)
+	{
+		const int left{row[i - bpp]};
+		const int upper_left{prev[i - bpp]};
+		sub[i] = static_cast<byte>(row[i] - left);
+		up[i] = static_cast<byte>(row[i] - prev[i]);
+		avg[i] = static_cast<byte>(row[i] - ((left + prev[i]) >> 1));
+		paeth[i] = static_cast<byte>(row[i] - paeth_predictor(left, prev[i], upper_left));
+	}
+}
+
+/**
+ * \brief The Shannon entropy of the filtered bytes, in bits for the whole row: a cheap stand-in for their compressed size.
+ */
+inline double entropy_cost(const byte* filtered, size_t rowbytes) noexcept
+{
+	// four histograms, so that runs of one value do not wait on the same counter
+	::std::array<::std::array<uint32_t, 256>, 4> counts{};
+	size_t i{0};
+	for (; i + 4 <= rowbytes; i += 4)
+	{
+		++counts[0][filtered[i]];
+		++counts[1][filtered[i + 1]];
+		++counts[2][filtered[i + 2]];
+		++counts[3][filtered[i + 3]];
+	}
+	for (; i < rowbytes; ++i)
+	{
+		++counts[0][filtered[i]];
+	}
+
+	// n log2(n) - sum of c log2(c) over the byte values
+	double bits{static_cast<double>(rowbytes) * ::std::log2(static_cast<double>(rowbytes))};
+	for (size_t value{0}; value < 256; ++value)
+	{
+		const uint32_t count{counts[0][value] + counts[1][value] + counts[2][value] + counts[3][value]};
+		if (count > 1)
+		{
+			bits -= count * ::std::log2(static_cast<double>(count));
+		}
+	}
+	return bits;
+}
+
+} // namespace detail
+
+/**
+ * \brief Picks a filter for every row of an image, the work libpng does in png_write_find_filter(), with a choice of heuristics.
+ *
+ * All allowed filters are applied to the row, with AVX2 where available, and rated:
+ *
+ * - filter_heuristic_min_sad: the sum of the filtered bytes taken as signed values, libpng's measure;
+ * - filter_heuristic_entropy: the entropy of the filtered bytes, slower but closer to what deflate makes of them;
+ * - filter_heuristic_sticky: as min_sad, but the filter of the previous row is kept unless the best one costs \a sticky_gain percent
+ *   less. Runs of one filter give deflate longer matches between rows.
+ *
+ * filter_heuristic_default is libpng's rule: min_sad, and when \a filters is 0, None only for palette and sub-byte images.
+ *
+ * \see encode_options::heuristic, strip_options::heuristic
+ */
+class filter_chooser
+{
+public:
+	explicit inline filter_chooser(const image_info& info, filter_heuristic heuristic = filter_heuristic_default, int filters = 0,
+		int sticky_gain = 10)
+		: m_rowbytes(info.get_rowbytes()), m_bpp(get_filter_bpp(info)), m_filters(filters), m_heuristic(heuristic), m_sticky_gain(sticky_gain),
+		m_candidates(4 * m_rowbytes), m_zeros(m_rowbytes)
+	{
+		if (m_filters == 0)
+		{
+			const bool unfiltered{info.get_color_type() == color_type_palette || info.get_bit_depth() < 8};
+			m_filters = m_heuristic == filter_heuristic_default && unfiltered ? PNG_FILTER_NONE : PNG_ALL_FILTERS;
+		}
+		if (m_heuristic == filter_heuristic_default)
+		{
+			m_heuristic = filter_heuristic_min_sad;
+		}
+	}
+
+	/**
+	 * \brief The filters chosen from, PNG_FILTER_NONE, PNG_FILTER_SUB, ... or'ed together.
+	 */
+	inline int get_filters() const noexcept
+	{
+		return m_filters;
+	}
+
+	/**
+	 * \brief Returns the filter for \a row. \a prev is the previous unfiltered row, or \c nullptr for the first row.
+	 *
+	 * The filtered bytes stay available from get_filtered() until the next call.
+	 */
+	inline row_filter choose(const byte* row, const byte* prev) noexcept
+	{
+		return choose(row, prev, m_filters);
+	}
+
+	/**
+	 * \brief Like choose() but only picks between None and Sub, the filters that do not look at the previous row.
+	 *
+	 * Used for the first row of an independently decodable segment, see strip_options::split_points.
+	 */
+	inline row_filter choose_independent(const byte* row) noexcept
+	{
+		const int filters{m_filters & (PNG_FILTER_NONE | PNG_FILTER_SUB)};
+		return choose(row, nullptr, filters != 0 ? filters : PNG_FILTER_NONE);
+	}
+
+	/**
+	 * \brief Returns the bytes of the row last passed to choose() filtered with \a filter.
+	 */
+	inline const byte* get_filtered(const byte* row, row_filter filter) const noexcept
+	{
+		return filter == row_filter_none ? row : m_candidates.data() + (filter - 1) * m_rowbytes;
+	}
+
+	/**
+	 * \brief Writes the filter type byte and the filtered bytes of \a row to \a out, which must hold rowbytes + 1 bytes.
+	 */
+	inline void filter(const byte* row, const byte* prev, byte* out) noexcept
+	{
+		write(row, choose(row, prev), out);
+	}
+
+	/**
+	 * \brief filter() with choose_independent().
+	 */
+	inline void filter_independent(const byte* row, byte* out) noexcept
+	{
+		write(row, choose_independent(row), out);
+	}
+
+	/**
+	 * \brief Forgets the previous row's filter, so the next row is chosen as if it was the first.
+	 */
+	inline void reset() noexcept
+	{
+		m_previous = -1;
+	}
+
+private:
+	inline row_filter choose(const byte* row, const byte* prev, int filters) noexcept
+	{
+		if ((filters & ~PNG_FILTER_NONE) == 0)
+		{
+			m_previous = row_filter_none;
+			return row_filter_none;
+		}
+		detail::filter_candidates(row, prev != nullptr ? prev : m_zeros.data(), m_candidates.data(), m_rowbytes, m_bpp);
+
+		::std::array<double, 5> costs{};
+		int best{-1};
+		for (int filter{row_filter_none}; filter <= row_filter_paeth; ++filter)
+		{
+			if ((filters & (PNG_FILTER_NONE << filter)) == 0)
+			{
+				continue;
+			}
+			const byte* filtered{get_filtered(row, static_cast<row_filter>(filter))};
+			costs[filter] = m_heuristic == filter_heuristic_entropy ? detail::entropy_cost(filtered, m_rowbytes)
+				: static_cast<double>(detail::filter_cost(filtered, m_rowbytes));
+			if (best < 0 || costs[filter] < costs[best])
+			{
+				best = filter;
+			}
+		}
+
+		if (m_heuristic == filter_heuristic_sticky && m_previous >= 0 && (filters & (PNG_FILTER_NONE << m_previous)) != 0)
+		{
+			if (costs[best] * 100 >= costs[m_previous] * (100 - m_sticky_gain))
+			{
+				best = m_previous;
+			}
+		}
+		m_previous = best;
+		return static_cast<row_filter>(best);
+	}
+
+	inline void write(const byte* row, row_filter filter, byte* out) const noexcept
+	{
+		out[0] = static_cast<byte>(filter);
+		::std::memcpy(out + 1, get_filtered(row, filter), m_rowbytes);
+	}
+
+	size_t m_rowbytes;
+	size_t m_bpp;
+	int m_filters;
+	filter_heuristic m_heuristic;
+	int m_sticky_gain;
+	int m_previous{-1};
+	::std::vector<byte> m_candidates;
+	::std::vector<byte> m_zeros;
+};
+
+} // namespace png
+
+#endif // PNGPP_FILTER_CHOOSER_HPP_INCLUDED
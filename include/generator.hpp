@@ -34,14 +34,19 @@
 #pragma once
 
 //#include <cassert>
+#include <algorithm>
+#include <array>
+#include <cstring>
 #include <stdexcept>
 #include <iostream>
 #include <ostream>
+#include <vector>
 
 #include "config.hpp"
 #include "error.hpp"
 #include "streaming_base.hpp"
 #include "writer.hpp"
+#include "filter_chooser.hpp"
 
 namespace png
 {
@@ -78,6 +83,12 @@ namespace png
  * avaiable as the only parameter of the method. For non-interlaced images the method is called once prior to any calls to \c get_next_row().
  * The value of \c 0 is passed for the \c pass number. You do not have to implement this method unless you are going to support interlaced %image generation.
  *
+ * A %generator may also implement \c get_next_rows(), see row_band_provider. Rows are then written row_band_size at a time with
+ * writer::write_rows(), which saves the fixed per-row cost on tall narrow images. The rows of a band must stay valid until the next call.
+ *
+ * A %generator whose rows all live in memory may instead implement \c get_row_pointers(), see row_pointers_provider; it is called after
+ * \c reset(0) and the whole image is written with writer::write_image().
+ *
  * An optional template parameter \c info_holder encapsulated image_info storage policy.
  * Please refer to consumer class documentation for the detailed description of this parameter.
  *
@@ -98,13 +109,17 @@ public:
 	 * \brief Writes an image to the stream.
 	 *
 	 * Essentially, this method constructs a writer object and instructs it to write the image to the stream.
-	 * It handles writing interlaced images as long as your generator class supports this.
+	 * It handles writing interlaced images as long as your generator class supports this. \a options sets the compression, see
+	 * encode_options; with a filter heuristic the rows are written one at a time, whatever the generator provides.
+	 *
+	 * Returns what libpng and zlib allocated for the image, see writer::get_memory_usage().
 	 */
 	template<typename ostream>
-	inline constexpr void write(ostream& stream)
+	inline constexpr memory_usage write(ostream& stream, const encode_options& options = encode_options())
 	{
 		writer<ostream> wr(stream);
 		wr.set_image_info(this->get_info());
+		wr.set_encode_options(options);
 		wr.write_info();
 
 		if constexpr (__little_endian)
@@ -147,22 +162,100 @@ public:
 		}
 
 		auto pixel_gen{static_cast<pixgen*>(this)};
+		const size_t height{this->get_info().get_height()};
+		if (options.heuristic != filter_heuristic_default && pass_count == 1)
+		{
+			write_chosen_filters(wr, options);
+			return wr.get_memory_usage();
+		}
+
+		if constexpr (row_pointers_provider<pixgen>)
+		{
+			pixel_gen->reset(0);
+			auto rows{pixel_gen->get_row_pointers()};
+			wr.write_image(rows.data());
+			wr.write_end_info();
+			return wr.get_memory_usage();
+		}
+
 		for (size_t pass{0}; pass < pass_count; ++pass)
 		{
 			pixel_gen->reset(pass);
 
-			for (size_t pos{0}; pos < this->get_info().get_height(); ++pos)
+			if constexpr (row_band_provider<pixgen>)
 			{
-				wr.write_row(pixel_gen->get_next_row(pos));
+				::std::array<byte*, row_band_size> rows;
+				for (size_t pos{0}; pos < height; pos += row_band_size)
+				{
+					const size_t count{::std::min(row_band_size, height - pos)};
+					pixel_gen->get_next_rows(pos, count, rows.data());
+					wr.write_rows(rows.data(), count);
+				}
+			}
+			else
+			{
+				for (size_t pos{0}; pos < height; ++pos)
+				{
+					wr.write_row(pixel_gen->get_next_row(pos));
+				}
 			}
 		}
 
 		wr.write_end_info();
+		return wr.get_memory_usage();
 	}
 
 protected:
 	using base = streaming_base<pixel, info_holder>;
 
+	/**
+	 * \brief Writes the rows one at a time, each with the filter a filter_chooser picks for it.
+	 */
+	template<typename writer_type>
+	inline void write_chosen_filters(writer_type& wr, const encode_options& options)
+	{
+		const image_info& info{this->get_info()};
+		const size_t rowbytes{info.get_rowbytes()};
+		filter_chooser chooser(info, options.heuristic, options.filters, options.sticky_gain);
+
+		// the rows as libpng filters them, 16-bit samples big-endian; a copy, since the generator may reuse its row buffer
+		::std::vector<byte> row(rowbytes);
+		::std::vector<byte> prev(rowbytes);
+		const bool swap{__little_endian && info.get_bit_depth() == 16};
+
+		auto pixel_gen{static_cast<pixgen*>(this)};
+		pixel_gen->reset(0);
+		for (size_t pos{0}; pos < info.get_height(); ++pos)
+		{
+			byte* bytes{reinterpret_cast<byte*>(pixel_gen->get_next_row(pos))};
+			if (swap)
+			{
+				for (size_t i{0}; i + 1 < rowbytes; i += 2)
+				{
+					row[i] = bytes[i + 1];
+					row[i + 1] = bytes[i];
+				}
+			}
+			else
+			{
+				::std::memcpy(row.data(), bytes, rowbytes);
+			}
+
+			row_filter filter{chooser.choose(row.data(), pos == 0 ? nullptr : prev.data())};
+			if (pos == 0 && (chooser.get_filters() & (PNG_FILTER_UP | PNG_FILTER_AVG | PNG_FILTER_PAETH)) != 0)
+			{
+				// libpng only keeps the previous row if the first row is written with a filter that needs it; above the first row
+				// everything is zero, which makes Up the same as None and Paeth the same as Sub
+				filter = filter == row_filter_none ? row_filter_up : filter == row_filter_sub ? row_filter_paeth : filter;
+			}
+			wr.set_filter(PNG_FILTER_NONE << filter);
+			wr.write_row(bytes);
+			row.swap(prev);
+		}
+
+		wr.write_end_info();
+	}
+
 	/**
 	 * \brief Constructs a generator object using passed image_info object to store image information.
 	 */
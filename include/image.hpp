@@ -34,6 +34,15 @@
 #pragma once
 
 #include <fstream>
+#include "mapped_file.hpp"
+#include "span_istream.hpp"
+#include "vector_ostream.hpp"
+#include "buffered_io.hpp"
+#include "strip_encoder.hpp"
+#include "fast_encoder.hpp"
+#include "split_index.hpp"
+#include "native_decoder.hpp"
+#include "probe.hpp"
 #include "pixel_buffer.hpp"
 #include "generator.hpp"
 #include "consumer.hpp"
@@ -111,16 +120,16 @@ public:
 	/**
 	 * \brief Constructs an image reading data from specified file using default converting transform.
 	 */
-	explicit inline constexpr image(const std::string& filename) noexcept
+	explicit inline constexpr image(const std::string& filename)
 	{
-		read(filename, transform_convert());
+		read(filename.c_str());
 	}
 
 	/**
 	 * \brief Constructs an image reading data from specified file using custom transformaton.
 	 */
 	template<typename transformation>
-	inline constexpr image(const std::string& filename, const transformation& transform) noexcept
+	inline constexpr image(const std::string& filename, const transformation& transform)
 	{
 		read(filename.c_str(), transform);
 	}
@@ -128,24 +137,41 @@ public:
 	/**
 	 * \brief Constructs an image reading data from specified file using default converting transform.
 	 */
-	explicit inline constexpr image(const char* filename) noexcept
+	explicit inline constexpr image(const char* filename)
 	{
-		read(filename, transform_convert());
+		read(filename);
 	}
 
 	/**
 	 * \brief Constructs an image reading data from specified file using custom transformaton.
 	 */
 	template<typename transformation>
-	inline constexpr image(const char* filename, const transformation& transform) noexcept
+	inline constexpr image(const char* filename, const transformation& transform)
 	{
 		read(filename, transform);
 	}
 
+	/**
+	 * \brief Constructs an image reading data from a memory buffer using default converting transform.
+	 */
+	explicit inline constexpr image(::std::span<const byte> bytes)
+	{
+		read(bytes);
+	}
+
+	/**
+	 * \brief Constructs an image reading data from a memory buffer using custom transformation.
+	 */
+	template<typename transformation>
+	inline constexpr image(::std::span<const byte> bytes, const transformation& transform)
+	{
+		read(bytes, transform);
+	}
+
 	/**
 	 * \brief Constructs an image reading data from a stream using default converting transform.
 	 */
-	explicit inline constexpr image(std::istream& stream) noexcept
+	explicit inline constexpr image(std::istream& stream)
 	{
 		read_stream(stream, transform_convert());
 	}
@@ -154,7 +180,7 @@ public:
 	 * \brief Constructs an image reading data from a stream using custom transformation.
 	 */
 	template<typename transformation>
-	inline constexpr image(std::istream& stream, const transformation& transform) noexcept
+	inline constexpr image(std::istream& stream, const transformation& transform)
 	{
 		read_stream(stream, transform);
 	}
@@ -162,47 +188,125 @@ public:
 	/**
 	 * \brief Reads an image from specified file using default converting transform.
 	 */
-	inline constexpr void read(const std::string& filename) noexcept
+	inline constexpr void read(const std::string& filename)
 	{
-		read(filename, transform_convert());
+		read(filename.c_str());
 	}
 
 	/**
 	 * \brief Reads an image from specified file using custom transformaton.
 	 */
 	template<typename transformation>
-	inline constexpr void read(const std::string& filename, const transformation& transform) noexcept
+	inline constexpr void read(const std::string& filename, const transformation& transform)
 	{
 		read(filename.c_str(), transform);
 	}
 
 	/**
 	 * \brief Reads an image from specified file using default converting transform.
+	 *
+	 * The file is memory mapped and read like a memory buffer, so plain 8-bit images take the native decoder, see read(::std::span<const byte>).
+	 */
+	inline void read(const char* filename)
+	{
+		mapped_file file(filename);
+		read(file.get_bytes());
+	}
+
+	/**
+	 * \brief Reads an image from specified file using default converting transform, making only the checks \a options asks for.
 	 */
-	inline constexpr void read(const char* filename) noexcept
+	inline void read(const char* filename, const decode_options& options)
 	{
-		read(filename, transform_convert());
+		mapped_file file(filename);
+		read(file.get_bytes(), options);
 	}
 
 	/**
 	 * \brief Reads an image from specified file using custom transformaton.
+	 *
+	 * The file is memory mapped rather than opened as a \c std::ifstream, see mapped_file.
 	 */
 	template<typename transformation>
 	inline constexpr void read(const char* filename, const transformation& transform)
 	{
-		std::ifstream stream(filename, std::ios::binary);
-		if (!stream.is_open())
+		mapped_file file(filename);
+		read_stream(file, transform);
+	}
+
+	/**
+	 * \brief Reads an image from a memory buffer using default converting transform.
+	 *
+	 * 8-bit non-interlaced images whose format is exactly \c pixel are decoded without libpng, see decode_native(); anything else, or a
+	 * file the native decoder turns down, goes through the reader as with read(bytes, transform_convert()).
+	 */
+	inline void read(::std::span<const byte> bytes)
+	{
+		read(bytes, decode_options());
+	}
+
+	/**
+	 * \brief Reads an image from a memory buffer using default converting transform, making only the checks \a options asks for.
+	 *
+	 * With decode_options::trusted() the native decoder skips the chunk CRCs and the Adler-32, and the reader is set up likewise, see
+	 * reader::read_info().
+	 */
+	inline void read(::std::span<const byte> bytes, const decode_options& options)
+	{
+		if (!read_native(bytes, options))
 		{
-			throw std_error(filename);
+			span_istream stream(bytes);
+			read_stream(stream, options);
 		}
-		stream.exceptions(std::ios::badbit);
+	}
+
+	/**
+	 * \brief Reads an image from a memory buffer using custom transformation.
+	 *
+	 * The decoder reads straight out of \a bytes, see span_istream. The buffer only has to stay alive for the duration of the call.
+	 */
+	template<typename transformation>
+	inline constexpr void read(::std::span<const byte> bytes, const transformation& transform)
+	{
+		span_istream stream(bytes);
 		read_stream(stream, transform);
 	}
 
+	/**
+	 * \brief Reads an image from a memory buffer, decoding the strips listed by an spIX chunk concurrently, see decode_split().
+	 *
+	 * Files without a valid spIX chunk, and files whose format is not exactly \c pixel, are read with read() instead.
+	 */
+	inline void read_parallel(::std::span<const byte> bytes, size_t thread_count = 0)
+	{
+		const auto index{scan_chunks(bytes)};
+		const auto points{find_split_points(index)};
+		if (points.empty() || !index.is_crc_ok() || !detail::is_native_layout<pixel>(index))
+		{
+			read(bytes);
+			return;
+		}
+
+		detail::fill_info(m_info, index);
+		m_pixbuf.resize(m_info.get_width(), m_info.get_height());
+
+		pixel_consumer pixcon(m_info, m_pixbuf);
+		decode_split(index, points, [&pixcon](size_t pos){ return pixcon.get_next_row(pos); }, thread_count);
+	}
+
+	/**
+	 * \brief Reads an image from specified file, decoding the strips listed by an spIX chunk concurrently, see decode_split().
+	 */
+	inline void read_parallel(const char* filename, size_t thread_count = 0)
+	{
+		mapped_file file(filename);
+		read_parallel(file.get_bytes(), thread_count);
+	}
+
 	/**
 	 * \brief Reads an image from a stream using default converting transform.
 	 */
-	inline constexpr void read(std::istream& stream) noexcept
+	inline constexpr void read(std::istream& stream)
 	{
 		read_stream(stream, transform_convert());
 	}
@@ -211,7 +315,7 @@ public:
 	 * \brief Reads an image from a stream using custom transformation.
 	 */
 	template<typename transformation>
-	inline constexpr void read(std::istream& stream, const transformation& transform) noexcept
+	inline constexpr void read(std::istream& stream, const transformation& transform)
 	{
 		read_stream(stream, transform);
 	}
@@ -219,8 +323,8 @@ public:
 	/**
 	 * \brief Reads an image from a stream using default converting transform.
 	 */
-	template<typename istream>
-	inline constexpr void read_stream(istream& stream) noexcept
+	template<input_stream istream>
+	inline constexpr void read_stream(istream& stream)
 	{
 		read_stream(stream, transform_convert());
 	}
@@ -228,25 +332,37 @@ public:
 	/**
 	 * \brief Reads an image from a stream using custom transformation.
 	 */
-	template<typename istream, typename transformation>
-	inline constexpr void read_stream(istream& stream, const transformation& transform) noexcept
+	template<input_stream istream, typename transformation>
+	inline constexpr void read_stream(istream& stream, const transformation& transform)
 	{
 		pixel_consumer pixcon(m_info, m_pixbuf);
 		pixcon.read(stream, transform);
 	}
 
+	/**
+	 * \brief Reads an image from a stream using default converting transform, making only the checks \a options asks for.
+	 */
+	template<input_stream istream>
+	inline constexpr void read_stream(istream& stream, const decode_options& options)
+	{
+		pixel_consumer pixcon(m_info, m_pixbuf);
+		pixcon.read(stream, transform_convert(), options);
+	}
+
 	/**
 	 * \brief Writes an image to specified file.
 	 */
-	inline constexpr void write(const std::string& filename) noexcept
+	inline constexpr void write(const std::string& filename)
 	{
 		write(filename.c_str());
 	}
 
 	/**
 	 * \brief Writes an image to specified file.
+	 *
+	 * The libpng writes are gathered in default_io_block_size blocks before they reach the file, see buffered_ostream.
 	 */
-	inline constexpr void write(const char* filename) noexcept
+	inline constexpr void write(const char* filename)
 	{
 		std::ofstream stream(filename, std::ios::binary);
 		if (!stream.is_open())
@@ -254,19 +370,146 @@ public:
 			throw std_error(filename);
 		}
 		stream.exceptions(std::ios::badbit);
-		write_stream(stream);
+		buffered_ostream<std::ofstream> buffered(stream);
+		write_stream(buffered);
+		buffered.flush();
 	}
 
 	/**
 	 * \brief Writes an image to a stream.
 	 */
 	template<typename ostream>
-	inline constexpr void write_stream(ostream& stream) noexcept
+	inline constexpr void write_stream(ostream& stream)
 	{
 		pixel_generator pixgen(m_info, m_pixbuf);
 		pixgen.write(stream);
 	}
 
+	/**
+	 * \brief Writes an image to specified file with the encoder \a mode selects, see encode_mode.
+	 */
+	inline void write(const char* filename, encode_mode mode)
+	{
+		std::ofstream stream(filename, std::ios::binary);
+		if (!stream.is_open())
+		{
+			throw std_error(filename);
+		}
+		stream.exceptions(std::ios::badbit);
+		buffered_ostream<std::ofstream> buffered(stream);
+		write_stream(buffered, mode);
+		buffered.flush();
+	}
+
+	inline void write(const std::string& filename, encode_mode mode)
+	{
+		write(filename.c_str(), mode);
+	}
+
+	/**
+	 * \brief Writes an image to a stream with the encoder \a mode selects, see encode_mode.
+	 *
+	 * With \c encode_mode_fast, images fast_encoder does not support (other bit depths, interlacing) are written by write_stream() instead.
+	 */
+	template<typename ostream>
+	inline void write_stream(ostream& stream, encode_mode mode)
+	{
+		if (mode != encode_mode_fast || !fast_encoder::is_supported(m_info))
+		{
+			write_stream(stream);
+			return;
+		}
+
+		pixel_generator pixgen(m_info, m_pixbuf);
+		fast_encoder encoder(m_info);
+		encoder.write(stream, [&pixgen](size_t pos){ return pixgen.get_next_row(pos); });
+	}
+
+	/**
+	 * \brief Writes an image to specified file with the compression settings in \a options, see encode_options.
+	 */
+	inline void write(const char* filename, const encode_options& options)
+	{
+		std::ofstream stream(filename, std::ios::binary);
+		if (!stream.is_open())
+		{
+			throw std_error(filename);
+		}
+		stream.exceptions(std::ios::badbit);
+		buffered_ostream<std::ofstream> buffered(stream);
+		write_stream(buffered, options);
+		buffered.flush();
+	}
+
+	inline void write(const std::string& filename, const encode_options& options)
+	{
+		write(filename.c_str(), options);
+	}
+
+	/**
+	 * \brief Writes an image to a stream with the compression settings in \a options, see encode_options.
+	 *
+	 * Returns what libpng and zlib allocated meanwhile, see writer::get_memory_usage().
+	 */
+	template<typename ostream>
+	inline memory_usage write_stream(ostream& stream, const encode_options& options)
+	{
+		pixel_generator pixgen(m_info, m_pixbuf);
+		return pixgen.write(stream, options);
+	}
+
+	/**
+	 * \brief Writes an image to specified file, filtering and deflating strips of rows on several threads, see strip_encoder.
+	 *
+	 * The file is identical whatever \c options.thread_count is. Interlaced images are written by write() instead.
+	 */
+	inline void write_parallel(const char* filename, const strip_options& options = strip_options())
+	{
+		std::ofstream stream(filename, std::ios::binary);
+		if (!stream.is_open())
+		{
+			throw std_error(filename);
+		}
+		stream.exceptions(std::ios::badbit);
+		buffered_ostream<std::ofstream> buffered(stream);
+		write_stream_parallel(buffered, options);
+		buffered.flush();
+	}
+
+	inline void write_parallel(const std::string& filename, const strip_options& options = strip_options())
+	{
+		write_parallel(filename.c_str(), options);
+	}
+
+	/**
+	 * \brief Writes an image to a stream, filtering and deflating strips of rows on several threads, see strip_encoder.
+	 */
+	template<typename ostream>
+	inline void write_stream_parallel(ostream& stream, const strip_options& options = strip_options())
+	{
+		if (m_info.get_interlace_type() != interlace_none)
+		{
+			write_stream(stream);
+			return;
+		}
+
+		pixel_generator pixgen(m_info, m_pixbuf);
+		strip_encoder encoder(m_info, options);
+		encoder.write(stream, [&pixgen](size_t pos){ return pixgen.get_next_row(pos); });
+	}
+
+	/**
+	 * \brief Encodes the image into memory and returns the PNG data stream.
+	 *
+	 * The output buffer is reserved from estimate_encoded_size() up front and moved out at the end instead of being copied.
+	 */
+	inline std::vector<byte> write_to_memory()
+	{
+		vector_ostream<> stream(estimate_encoded_size(m_info));
+		write_stream(stream);
+		return stream.release();
+	}
+
 	/**
 	 * \brief Returns a reference to image pixel buffer.
 	 */
@@ -464,10 +707,64 @@ protected:
 			return reinterpret_cast<byte*>(row_traits::get_data(m_pixbuf.get_row(pos)));
 		}
 
+		/**
+		 * \brief Returns the starting address of every row, see row_pointers_provider. Only for pixel buffers that can list them.
+		 */
+		inline ::std::vector<byte*> get_row_pointers() requires requires(pixbuf& pixels) { pixels.get_row_pointers(); }
+		{
+			return m_pixbuf.get_row_pointers();
+		}
+
+		/**
+		 * \brief Stores the starting addresses of rows \c pos to \c pos + \a count - 1 in \a rows, see row_band_provider.
+		 */
+		inline constexpr void get_next_rows(size_t pos, size_t count, byte** rows) noexcept
+		{
+			for (size_t i{0}; i < count; ++i)
+			{
+				rows[i] = get_next_row(pos + i);
+			}
+		}
+
 	protected:
 		pixbuf& m_pixbuf;
 	};
 
+	/**
+	 * \brief Decodes \a bytes with decode_native() if detail::can_decode_native() accepts them; returns \c false, with the image untouched,
+	 * otherwise.
+	 */
+	inline bool read_native(::std::span<const byte> bytes, const decode_options& options)
+	{
+		image_info header;
+		if (!try_probe(bytes, header) || header.get_bit_depth() != 8 || header.get_color_type() != pixel_traits<pixel>::get_color_type()
+			|| header.get_interlace_type() != interlace_none)
+		{
+			return false;
+		}
+
+		const auto index{scan_chunks(bytes, scan_options{options.verify_crc})};
+		if (!detail::can_decode_native<pixel>(index))
+		{
+			return false;
+		}
+
+		detail::fill_info(m_info, index);
+		m_pixbuf.resize(m_info.get_width(), m_info.get_height());
+
+		if constexpr (requires(pixbuf& pixels) { { pixels.get_storage() } -> ::std::same_as<::std::vector<byte>&>; })
+		{
+			// contiguous rows: inflate straight into the pixel storage and unfilter there
+			decode_native_whole(index, m_pixbuf.get_storage(), options);
+		}
+		else
+		{
+			pixel_consumer pixcon(m_info, m_pixbuf);
+			decode_native(index, [&pixcon](size_t pos){ return pixcon.get_next_row(pos); }, options);
+		}
+		return true;
+	}
+
 	/**
 	 * \brief The pixel buffer adapter for reading pixel data.
 	 */
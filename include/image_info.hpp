@@ -35,6 +35,7 @@
 
 #include <ranges>
 #include <algorithm>
+#include <array>
 
 #include "types.hpp"
 #include "palette.hpp"
@@ -144,6 +145,35 @@ public:
 		m_bit_depth = bit_depth;
 	}
 
+	/**
+	 * \brief Returns the number of channels per pixel implied by the color type, or 0 if the color type is not set.
+	 */
+	inline constexpr int get_channels() const noexcept
+	{
+		switch (m_color_type)
+		{
+		case color_type_gray:
+		case color_type_palette:
+			return 1;
+		case color_type_ga:
+			return 2;
+		case color_type_rgb:
+			return 3;
+		case color_type_rgba:
+			return 4;
+		default:
+			return 0;
+		}
+	}
+
+	/**
+	 * \brief Returns the number of bytes in one unfiltered row of image data, as stored in the PNG data stream.
+	 */
+	inline constexpr size_t get_rowbytes() const noexcept
+	{
+		return (static_cast<size_t>(m_width) * get_channels() * m_bit_depth + 7) / 8;
+	}
+
 	inline constexpr interlace_type get_interlace_type() const noexcept
 	{
 		return m_interlace_type;
@@ -209,8 +239,7 @@ public:
 
 	inline void set_tRNS(const tRNS& trns) noexcept
 	{
-		m_tRNS.clear();
-		::std::ranges::copy(trns, m_tRNS.begin());
+		m_tRNS = trns;
 	}
 
 	inline constexpr double get_gamma() const noexcept
@@ -249,6 +278,59 @@ inline constexpr image_info make_image_info() noexcept
 	return info;
 }
 
+/**
+ * \brief Returns an estimate of the size of the PNG data stream encoded from \a info, meant to err on the large side.
+ *
+ * Counts the signature, IHDR, PLTE, tRNS, gAMA, IEND and the IDAT chunks holding an incompressible (stored) zlib stream split at the
+ * default 8 KiB libpng compression buffer, with the filter bytes of every Adam7 pass row for interlaced images. Other chunks, smaller
+ * IDAT chunks and zlib output beyond the stored size are not counted, so this is a size to reserve up front, not a guarantee.
+ */
+inline constexpr size_t estimate_encoded_size(const image_info& info) noexcept
+{
+	constexpr const size_t chunk_overhead{12};		// length, type and CRC
+	constexpr const size_t idat_size{8192};			// PNG_ZBUF_SIZE
+
+	size_t filtered{info.get_height() * (info.get_rowbytes() + 1)};
+	if (info.get_interlace_type() == interlace_adam7)
+	{
+		// every pass row gets its own filter byte and a partial byte at the end of a row at low bit depths
+		constexpr const ::std::array<size_t, 7> x_start{0, 4, 0, 2, 0, 1, 0};
+		constexpr const ::std::array<size_t, 7> x_step{8, 8, 4, 4, 2, 2, 1};
+		constexpr const ::std::array<size_t, 7> y_start{0, 0, 4, 0, 2, 0, 1};
+		constexpr const ::std::array<size_t, 7> y_step{8, 8, 8, 4, 4, 2, 2};
+		const size_t width{info.get_width()};
+		const size_t height{info.get_height()};
+		const size_t pixel_bits{static_cast<size_t>(info.get_channels()) * info.get_bit_depth()};
+		filtered = 0;
+		for (size_t pass{0}; pass < 7; ++pass)
+		{
+			if (width > x_start[pass] && height > y_start[pass])
+			{
+				const size_t columns{(width - x_start[pass] + x_step[pass] - 1) / x_step[pass]};
+				const size_t rows{(height - y_start[pass] + y_step[pass] - 1) / y_step[pass]};
+				filtered += rows * ((columns * pixel_bits + 7) / 8 + 1);
+			}
+		}
+	}
+	const size_t zlib{filtered + 5 * (filtered / 16383 + 1) + 6};
+	const size_t idat{zlib + chunk_overhead * (zlib / idat_size + 1)};
+
+	size_t size{8 + (chunk_overhead + 13) + idat + chunk_overhead};
+	if (!info.get_palette().empty())
+	{
+		size += chunk_overhead + 3 * info.get_palette().size();
+	}
+	if (!info.get_tRNS().empty())
+	{
+		size += chunk_overhead + info.get_tRNS().size();
+	}
+	if (info.get_gamma() > 0)
+	{
+		size += chunk_overhead + 4;
+	}
+	return size;
+}
+
 } // namespace png
 
 #endif // PNGPP_IMAGE_INFO_HPP_INCLUDED
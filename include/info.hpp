@@ -54,6 +54,16 @@ public:
 		//assert(m_info);
 
 		png_read_info(m_png.get(), m_info.get());
+		fetch();
+	}
+
+	/**
+	 * \brief Copies the IHDR, PLTE, tRNS and gAMA values libpng has already parsed into this object.
+	 *
+	 * Called by read(); the progressive reader calls it directly from its info callback.
+	 */
+	inline void fetch()
+	{
 		png_get_IHDR(m_png.get(), m_info.get(), &m_width, &m_height,
 			reinterpret_cast<int*>(&m_bit_depth),
 			reinterpret_cast<int*>(&m_color_type),
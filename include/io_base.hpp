@@ -459,7 +459,10 @@ protected:
 		longjmp(png_jmpbuf(m_png.get()), -1);
 	}
 
-	static inline void raise_error(png_struct* png, ::std::string_view message) noexcept
+	/**
+	 * \brief The png_error_ptr handed to libpng: records \a message and jumps back to the setjmp() of the call in progress.
+	 */
+	static inline void raise_error(png_struct* png, png_const_charp message) noexcept
 	{
 		auto io{static_cast<io_base*>(png_get_error_ptr(png))};
 		io->set_error(message);
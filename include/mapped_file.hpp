@@ -0,0 +1,255 @@
+/**********************************************************************************************************************************************\
+	Copyright© 2021 Mason DeRoss
+
+	Released under either the GNU All-permissive License or MIT license. You pick.
+
+	Copying and distribution of this file, with or without modification, are permitted in any medium without royalty,
+	provided the copyright notice and this notice are preserved. This file is offered as-is, without any warranty.
+
+	DESCRIPTION:
+		Read-only memory mapped file, usable as the input stream of png::reader.
+
+\**********************************************************************************************************************************************/
+#ifndef PNGPP_MAPPED_FILE_HPP_INCLUDED
+#define PNGPP_MAPPED_FILE_HPP_INCLUDED
+
+#pragma once
+
+#include <span>
+#include <string>
+#include <cerrno>
+#include <cstring>
+
+#if defined(_WIN32)
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+#include "types.hpp"
+#include "error.hpp"
+
+namespace png
+{
+
+/**
+ * \brief Maps a whole file read-only into memory.
+ *
+ * Implements the \c istream interface expected by the reader class, so it can be used anywhere a \c std::ifstream was used before:
+ *
+ * \code
+ * png::mapped_file file("input.png");
+ * png::reader<png::mapped_file> rd(file);
+ * \endcode
+ *
+ * Each \c read() copies straight from the mapped pages into the libpng buffer, skipping the intermediate iostream buffer and the read
+ * syscalls behind it. The mapping is hinted for sequential access. The mapped bytes are also available directly through \c get_bytes().
+ *
+ * \see reader, image
+ */
+class mapped_file
+{
+private:
+	mapped_file() = delete;
+
+	mapped_file(const mapped_file&) = delete;
+	mapped_file(mapped_file&&) = delete;
+
+	mapped_file& operator=(const mapped_file&) = delete;
+	mapped_file& operator=(mapped_file&&) = delete;
+
+public:
+	/**
+	 * \brief Maps the file named \a filename. Throws std_error if the file cannot be opened or mapped.
+	 */
+	explicit inline mapped_file(const char* filename)
+	{
+		open(filename);
+	}
+
+	explicit inline mapped_file(const ::std::string& filename)
+	{
+		open(filename.c_str());
+	}
+
+	inline ~mapped_file() noexcept
+	{
+		close();
+	}
+
+	/**
+	 * \brief Copies the next \a length bytes into \a data. Reading past the end of the file clears the good() flag.
+	 */
+	inline void read(char* data, size_t length) noexcept
+	{
+		if (length > m_size - m_pos)
+		{
+			m_good = false;
+			length = m_size - m_pos;
+		}
+		if (length > 0)
+		{
+			::std::memcpy(data, m_data + m_pos, length);
+			m_pos += length;
+		}
+	}
+
+	inline constexpr bool good() const noexcept
+	{
+		return m_good;
+	}
+
+	inline constexpr const byte* data() const noexcept
+	{
+		return m_data;
+	}
+
+	inline constexpr size_t size() const noexcept
+	{
+		return m_size;
+	}
+
+	/**
+	 * \brief Returns the whole mapping. The span is valid for the lifetime of the mapped_file object.
+	 */
+	inline constexpr ::std::span<const byte> get_bytes() const noexcept
+	{
+		return {m_data, m_size};
+	}
+
+private:
+#if defined(_WIN32)
+	inline void open(const char* filename)
+	{
+		HANDLE file{CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr)};
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			throw std_error(filename, get_errno(GetLastError()));
+		}
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file, &size))
+		{
+			const int errnum{get_errno(GetLastError())};
+			CloseHandle(file);
+			throw std_error(filename, errnum);
+		}
+		m_size = static_cast<size_t>(size.QuadPart);
+
+		// zero length files cannot be mapped; leave m_data empty and let read() report the failure
+		if (m_size > 0)
+		{
+			m_mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			const int errnum{get_errno(GetLastError())};
+			CloseHandle(file);
+			if (!m_mapping)
+			{
+				throw std_error(filename, errnum);
+			}
+			m_data = static_cast<const byte*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+			if (!m_data)
+			{
+				const int view_errnum{get_errno(GetLastError())};
+				CloseHandle(m_mapping);
+				throw std_error(filename, view_errnum);
+			}
+		}
+		else
+		{
+			CloseHandle(file);
+		}
+	}
+
+	/**
+	 * \brief The errno value closest to the Windows error \a code, so that std_error describes it the same way on every platform.
+	 */
+	static inline int get_errno(DWORD code) noexcept
+	{
+		switch (code)
+		{
+		case ERROR_FILE_NOT_FOUND:
+		case ERROR_PATH_NOT_FOUND:
+		case ERROR_INVALID_NAME:
+			return ENOENT;
+		case ERROR_ACCESS_DENIED:
+		case ERROR_SHARING_VIOLATION:
+		case ERROR_LOCK_VIOLATION:
+			return EACCES;
+		case ERROR_NOT_ENOUGH_MEMORY:
+		case ERROR_OUTOFMEMORY:
+			return ENOMEM;
+		case ERROR_TOO_MANY_OPEN_FILES:
+			return EMFILE;
+		default:
+			return EIO;
+		}
+	}
+
+	inline void close() noexcept
+	{
+		if (m_data)
+		{
+			UnmapViewOfFile(m_data);
+			CloseHandle(m_mapping);
+		}
+	}
+
+	HANDLE m_mapping{nullptr};
+#else
+	inline void open(const char* filename)
+	{
+		int fd{::open(filename, O_RDONLY)};
+		if (fd < 0)
+		{
+			throw std_error(filename);
+		}
+
+		struct stat st;
+		if (fstat(fd, &st) != 0)
+		{
+			int errnum{errno};
+			::close(fd);
+			throw std_error(filename, errnum);
+		}
+		m_size = static_cast<size_t>(st.st_size);
+
+		// zero length files cannot be mapped; leave m_data empty and let read() report the failure
+		if (m_size > 0)
+		{
+			void* addr{mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0)};
+			int errnum{errno};
+			::close(fd);
+			if (addr == MAP_FAILED)
+			{
+				throw std_error(filename, errnum);
+			}
+			madvise(addr, m_size, MADV_SEQUENTIAL);
+			m_data = static_cast<const byte*>(addr);
+		}
+		else
+		{
+			::close(fd);
+		}
+	}
+
+	inline void close() noexcept
+	{
+		if (m_data)
+		{
+			munmap(const_cast<byte*>(m_data), m_size);
+		}
+	}
+#endif
+
+	const byte* m_data{nullptr};
+	size_t m_size{0};
+	size_t m_pos{0};
+	bool m_good{true};
+};
+
+} // namespace png
+
+#endif // PNGPP_MAPPED_FILE_HPP_INCLUDED
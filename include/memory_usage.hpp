@@ -0,0 +1,111 @@
+/**********************************************************************************************************************************************\
+	Copyright© 2021 Mason DeRoss
+
+	Released under either the GNU All-permissive License or MIT license. You pick.
+
+	Copying and distribution of this file, with or without modification, are permitted in any medium without royalty,
+	provided the copyright notice and this notice are preserved. This file is offered as-is, without any warranty.
+
+	DESCRIPTION:
+		Accounting of the memory libpng and zlib allocate on behalf of one png_struct.
+
+\**********************************************************************************************************************************************/
+#ifndef PNGPP_MEMORY_USAGE_HPP_INCLUDED
+#define PNGPP_MEMORY_USAGE_HPP_INCLUDED
+
+#pragma once
+
+#include <algorithm>
+#include <cstdlib>
+#include <unordered_map>
+
+extern "C"
+{
+	#include <png.h>
+}
+
+namespace png
+{
+
+/**
+ * \brief What libpng and zlib allocated for one writer, zlib's deflate state and window included.
+ *
+ * \see writer::get_memory_usage()
+ */
+struct memory_usage
+{
+	size_t current{0};							// bytes held now
+	size_t peak{0};								// the most bytes held at once
+	size_t allocations{0};						// number of allocations so far
+};
+
+namespace detail
+{
+
+/**
+ * \brief The allocation callbacks of png_create_write_struct_2(), which count every block in a memory_usage.
+ *
+ * Classes using it derive from it ahead of io_base, so the counter exists before the png_struct that reports to it and outlives it.
+ */
+class memory_counter
+{
+public:
+	inline memory_counter() noexcept = default;
+
+	memory_counter(const memory_counter&) = delete;
+	memory_counter& operator=(const memory_counter&) = delete;
+
+	/**
+	 * \brief Returns the bytes libpng and zlib hold now and the most they have held.
+	 */
+	inline memory_usage get_memory_usage() const noexcept
+	{
+		return m_usage;
+	}
+
+protected:
+	static inline png_voidp allocate(png_struct* png, png_alloc_size_t size) noexcept
+	{
+		auto counter{static_cast<memory_counter*>(png_get_mem_ptr(png))};
+		void* block{::std::malloc(size)};
+		if (block == nullptr)
+		{
+			return nullptr;
+		}
+		try
+		{
+			// the sizes are kept aside rather than in front of the blocks, which stay plain malloc() blocks
+			counter->m_sizes.emplace(block, size);
+		}
+		catch (...)
+		{
+			::std::free(block);
+			return nullptr;
+		}
+		counter->m_usage.current += size;
+		counter->m_usage.peak = ::std::max(counter->m_usage.peak, counter->m_usage.current);
+		++counter->m_usage.allocations;
+		return block;
+	}
+
+	static inline void release(png_struct* png, png_voidp block) noexcept
+	{
+		auto counter{static_cast<memory_counter*>(png_get_mem_ptr(png))};
+		if (auto found{counter->m_sizes.find(block)}; found != counter->m_sizes.end())
+		{
+			counter->m_usage.current -= found->second;
+			counter->m_sizes.erase(found);
+		}
+		::std::free(block);
+	}
+
+private:
+	memory_usage m_usage;
+	::std::unordered_map<void*, size_t> m_sizes;
+};
+
+} // namespace detail
+
+} // namespace png
+
+#endif // PNGPP_MEMORY_USAGE_HPP_INCLUDED
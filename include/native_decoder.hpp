@@ -0,0 +1,253 @@
+/****************************************************************************************************************************************************\
+	Copyright© 2021 Mason DeRoss
+
+	Released under either the GNU All-permissive License or MIT license. You pick.
+
+	Copying and distribution of this file, with or without modification, are permitted in any medium without royalty,
+	provided the copyright notice and this notice are preserved. This file is offered as-is, without any warranty.
+
+	DESCRIPTION:
+		Decodes plain 8-bit non-interlaced images without libpng: zlib inflate and SIMD unfiltering straight into the pixel rows,
+		streamed a batch of rows at a time, or inflated in one shot into contiguous storage.
+
+\**********************************************************************************************************************************************/
+#ifndef PNGPP_NATIVE_DECODER_HPP_INCLUDED
+#define PNGPP_NATIVE_DECODER_HPP_INCLUDED
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <span>
+#include <vector>
+
+#include "types.hpp"
+#include "error.hpp"
+#include "color.hpp"
+#include "palette.hpp"
+#include "tRNS.hpp"
+#include "image_info.hpp"
+#include "chunk.hpp"
+#include "chunk_scanner.hpp"
+#include "decode_options.hpp"
+#include "filter.hpp"
+#include "pixel_traits.hpp"
+#include "split_index.hpp"
+#include "zstream.hpp"
+
+namespace png
+{
+
+namespace detail
+{
+
+/**
+ * \brief Fills \a info with what the reader would have read from the chunks in \a index: IHDR, PLTE, tRNS for palette images and gAMA.
+ */
+inline void fill_info(image_info& info, const chunk_index& index)
+{
+	info = index.info;
+
+	if (const chunk_record* plte{index.find(chunk_type_PLTE)}; plte && index.info.get_color_type() == color_type_palette)
+	{
+		palette entries;
+		const auto data{plte->chunk.data};
+		for (size_t i{0}; i + 2 < data.size(); i += 3)
+		{
+			entries.push_back(color(data[i], data[i + 1], data[i + 2]));
+		}
+		info.set_palette(entries);
+
+		if (const chunk_record* trns{index.find(chunk_type_tRNS)})
+		{
+			info.set_tRNS(tRNS(trns->chunk.data.begin(), trns->chunk.data.end()));
+		}
+	}
+
+	if (const chunk_record* gama{index.find(chunk_type_gAMA)}; gama && gama->chunk.data.size() == 4)
+	{
+		info.set_gamma(load_be32(gama->chunk.data.data()) / 100000.0);
+	}
+}
+
+/**
+ * \brief Returns \c true if decode_native() can decode the image in \a index into rows of its own format.
+ *
+ * That is an 8-bit non-interlaced image with intact chunks, one run of IDAT chunks, no critical chunks other than IHDR, PLTE, IDAT and
+ * IEND and, for palette images, a PLTE chunk. Everything else is left to the reader.
+ */
+inline bool can_decode_native(const chunk_index& index) noexcept
+{
+	if (index.info.get_bit_depth() != 8 || index.info.get_interlace_type() != interlace_none
+		|| !index.has_iend || index.is_truncated || !index.is_crc_ok() || index.idat_runs.size() != 1)
+	{
+		return false;
+	}
+	if (index.info.get_color_type() == color_type_palette && !index.find(chunk_type_PLTE))
+	{
+		return false;
+	}
+	return ::std::ranges::none_of(index.chunks, [](const chunk_record& r)
+	{
+		const chunk_type type{r.chunk.type};
+		return !is_ancillary(type) && type != chunk_type_IHDR && type != chunk_type_PLTE && type != chunk_type_IDAT && type != chunk_type_IEND;
+	});
+}
+
+/**
+ * \brief Returns \c true if decode_native() can decode the image in \a index into rows of \c pixel: can_decode_native(index) and
+ * \c pixel has the color type of the image and 8 bits per sample.
+ */
+template<typename pixel>
+inline bool can_decode_native(const chunk_index& index) noexcept
+{
+	return pixel_traits<pixel>::get_bit_depth() == 8 && index.info.get_color_type() == pixel_traits<pixel>::get_color_type()
+		&& can_decode_native(index);
+}
+
+} // namespace detail
+
+/**
+ * \brief Decodes the image data of \a index into the rows given by \a get_row(pos), bypassing libpng.
+ *
+ * The zlib stream is inflated a batch of rows at a time, and every row is copied to its destination and unfiltered there with
+ * unfilter_row_fast(), using the destination row above as the previous row. The zlib Adler-32 is checked unless \a options says
+ * otherwise. Meant for images accepted by detail::can_decode_native(); throws png::error on corrupt data.
+ */
+template<typename row_target>
+inline void decode_native(const chunk_index& index, const row_target& get_row, const decode_options& options = decode_options())
+{
+	const size_t rowbytes{index.info.get_rowbytes()};
+	const size_t stride{rowbytes + 1};
+	const size_t bpp{get_filter_bpp(index.info)};
+	const size_t height{index.info.get_height()};
+
+	const detail::idat_stream stream(index);
+	detail::inflate_stream inflater(15);
+	if (!options.verify_adler)
+	{
+		inflater.skip_check();
+	}
+	::std::vector<byte> zeros(rowbytes);
+	::std::vector<byte> buffer(::std::max<size_t>(1, (64 << 10) / stride) * stride);
+	size_t filled{0};
+	size_t pos{0};
+	const byte* prev{zeros.data()};
+
+	stream.for_each(0, stream.size(), [&](::std::span<const byte> piece)
+	{
+		while (!piece.empty() && !inflater.is_end())
+		{
+			filled += inflater.inflate(piece, ::std::span(buffer).subspan(filled));
+
+			const byte* row{buffer.data()};
+			for (; filled >= stride && pos < height; filled -= stride, row += stride, ++pos)
+			{
+				byte* out{reinterpret_cast<byte*>(get_row(pos))};
+				::std::memcpy(out, row + 1, rowbytes);
+				detail::unfilter_row_fast(row[0], out, prev, rowbytes, bpp);
+				prev = out;
+			}
+			if (filled >= stride)
+			{
+				throw error("decode_native: too much image data");
+			}
+			::std::memmove(buffer.data(), row, filled);
+		}
+		return !inflater.is_end();
+	});
+
+	if (!inflater.is_end() || pos != height || filled != 0)
+	{
+		throw error("decode_native: not enough image data");
+	}
+}
+
+namespace detail
+{
+
+/**
+ * \brief Inflates the whole zlib stream of \a index into \a filtered, which must be exactly the size of the filtered image data.
+ *
+ * The IDAT payloads are fed to one inflate call each, straight from the file buffer, with the whole of \a filtered as output, so zlib stays
+ * in its fast loop across chunk boundaries. Throws png::error unless the stream ends, with a correct Adler-32 if
+ * \a options asks for it, right at the end of \a filtered.
+ */
+inline void inflate_whole(const chunk_index& index, ::std::span<byte> filtered, const decode_options& options = decode_options())
+{
+	const idat_stream stream(index);
+	inflate_stream inflater(15);
+	if (!options.verify_adler)
+	{
+		inflater.skip_check();
+	}
+	size_t produced{0};
+
+	stream.for_each(0, stream.size(), [&](::std::span<const byte> piece)
+	{
+		while (!piece.empty() && !inflater.is_end())
+		{
+			const size_t count{inflater.inflate(piece, filtered.subspan(produced))};
+			produced += count;
+			if (count == 0 && produced == filtered.size() && !piece.empty())
+			{
+				// the output is full, so anything but the Adler-32 left in the stream is too much image data
+				::std::array<byte, 1> excess;
+				if (inflater.inflate(piece, excess) != 0)
+				{
+					throw error("decode_native: too much image data");
+				}
+			}
+		}
+		return !inflater.is_end();
+	});
+
+	if (!inflater.is_end() || produced != filtered.size())
+	{
+		throw error("decode_native: not enough image data");
+	}
+}
+
+} // namespace detail
+
+/**
+ * \brief Decodes the image data of \a index into \a pixels, rows stored back to back, inflating it in one shot.
+ *
+ * \a pixels is first grown to the size of the filtered image data and inflated into; each row is then moved down over the filter bytes in
+ * front of it and unfiltered in place, and \a pixels is shrunk to \c height * \c rowbytes. No buffer besides \a pixels is used (the first
+ * row is unfiltered with unfilter_first_row()), and its capacity is kept for the next image. Same conditions as decode_native().
+ *
+ * For row-addressed destinations decode_native() is the faster choice: it keeps its batch of filtered rows in cache.
+ */
+inline void decode_native_whole(const chunk_index& index, ::std::vector<byte>& pixels, const decode_options& options = decode_options())
+{
+	const size_t rowbytes{index.info.get_rowbytes()};
+	const size_t stride{rowbytes + 1};
+	const size_t bpp{get_filter_bpp(index.info)};
+	const size_t height{index.info.get_height()};
+
+	pixels.resize(height * stride);
+	detail::inflate_whole(index, pixels, options);
+
+	for (size_t pos{0}; pos < height; ++pos)
+	{
+		// the row moves left by pos + 1 bytes, never over the rows in front of it or the next filter byte
+		const int filter{pixels[pos * stride]};
+		byte* row{pixels.data() + pos * rowbytes};
+		::std::memmove(row, pixels.data() + pos * stride + 1, rowbytes);
+		if (pos == 0)
+		{
+			detail::unfilter_first_row(filter, row, rowbytes, bpp);
+		}
+		else
+		{
+			detail::unfilter_row_fast(filter, row, row - rowbytes, rowbytes, bpp);
+		}
+	}
+	pixels.resize(height * rowbytes);
+}
+
+} // namespace png
+
+#endif // PNGPP_NATIVE_DECODER_HPP_INCLUDED
@@ -56,15 +56,40 @@ extern "C"
 #include "info.hpp"
 #include "end_info.hpp"
 #include "io_base.hpp"
+#include "checksum.hpp"
+#include "chunk.hpp"
+#include "probe.hpp"
+#include "chunk_scanner.hpp"
+#include "mapped_file.hpp"
+#include "span_istream.hpp"
+#include "vector_ostream.hpp"
+#include "buffered_io.hpp"
+#include "async_file.hpp"
+#include "filter.hpp"
+#include "zstream.hpp"
+#include "worker_threads.hpp"
+#include "encode_options.hpp"
+#include "decode_options.hpp"
+#include "memory_usage.hpp"
+#include "filter_chooser.hpp"
 #include "reader.hpp"
 #include "writer.hpp"
 #include "generator.hpp"
 #include "consumer.hpp"
+#include "push_reader.hpp"
+#include "split_index.hpp"
+#include "row_index.hpp"
+#include "native_decoder.hpp"
+#include "strip_encoder.hpp"
+#include "fast_encoder.hpp"
 #include "pixel_buffer.hpp"
 #include "solid_pixel_buffer.hpp"
 #include "require_color_space.hpp"
 #include "convert_color_space.hpp"
 #include "image.hpp"
+#include "batch_decoder.hpp"
+#include "validate.hpp"
+#include "chunk_editor.hpp"
 
 /**
  * \mainpage
@@ -0,0 +1,147 @@
+/**********************************************************************************************************************************************\
+	Copyright© 2021 Mason DeRoss
+
+	Released under either the GNU All-permissive License or MIT license. You pick.
+
+	Copying and distribution of this file, with or without modification, are permitted in any medium without royalty,
+	provided the copyright notice and this notice are preserved. This file is offered as-is, without any warranty.
+
+	DESCRIPTION:
+		IHDR-only probe: image dimensions and format without building a libpng read context.
+
+\**********************************************************************************************************************************************/
+#ifndef PNGPP_PROBE_HPP_INCLUDED
+#define PNGPP_PROBE_HPP_INCLUDED
+
+#pragma once
+
+#include <cstdio>
+#include <filesystem>
+#include <span>
+#include <string>
+
+#include "types.hpp"
+#include "error.hpp"
+#include "chunk.hpp"
+#include "image_info.hpp"
+
+namespace png
+{
+
+/**
+ * \brief The number of bytes probe() needs: the signature followed by the complete IHDR chunk.
+ */
+inline constexpr const size_t probe_size{8 + chunk_overhead + 13};
+
+namespace detail
+{
+
+inline constexpr bool is_valid_bit_depth(int color, int bit_depth) noexcept
+{
+	switch (color)
+	{
+	case color_type_gray:
+		return bit_depth == 1 || bit_depth == 2 || bit_depth == 4 || bit_depth == 8 || bit_depth == 16;
+	case color_type_palette:
+		return bit_depth == 1 || bit_depth == 2 || bit_depth == 4 || bit_depth == 8;
+	case color_type_rgb:
+	case color_type_ga:
+	case color_type_rgba:
+		return bit_depth == 8 || bit_depth == 16;
+	default:
+		return false;
+	}
+}
+
+} // namespace detail
+
+/**
+ * \brief Parses the signature and IHDR at the start of \a bytes into \a info. Does not allocate and does not throw.
+ *
+ * Only the first probe_size bytes are looked at; the IHDR CRC is not verified.
+ *
+ * \return \c false if \a bytes does not start with a well-formed PNG signature and IHDR chunk.
+ */
+inline bool try_probe(::std::span<const byte> bytes, image_info& info) noexcept
+{
+	if (bytes.size() < probe_size || !has_png_signature(bytes))
+	{
+		return false;
+	}
+
+	const byte* ihdr{bytes.data() + png_signature.size()};
+	if (load_be32(ihdr) != 13 || load_be32(ihdr + 4) != chunk_type_IHDR)
+	{
+		return false;
+	}
+
+	const byte* fields{ihdr + 8};
+	const uint32_t width{load_be32(fields)};
+	const uint32_t height{load_be32(fields + 4)};
+	const int bit_depth{fields[8]};
+	const int color{fields[9]};
+	if (width == 0 || height == 0 || width > PNG_UINT_31_MAX || height > PNG_UINT_31_MAX
+		|| !detail::is_valid_bit_depth(color, bit_depth)
+		|| fields[10] != PNG_COMPRESSION_TYPE_BASE || fields[11] != PNG_FILTER_TYPE_BASE || fields[12] > PNG_INTERLACE_ADAM7)
+	{
+		return false;
+	}
+
+	info.set_width(width);
+	info.set_height(height);
+	info.set_bit_depth(bit_depth);
+	info.set_color_type(static_cast<color_type>(color));
+	info.set_compression_type(static_cast<compression_type>(fields[10]));
+	info.set_filter_type(static_cast<filter_type>(fields[11]));
+	info.set_interlace_type(static_cast<interlace_type>(fields[12]));
+	return true;
+}
+
+/**
+ * \brief Returns the width, height, bit depth, color type and interlace type of the PNG image in \a bytes.
+ *
+ * A much cheaper alternative to constructing a reader and calling reader::read_info() when only the IHDR is needed: no libpng structures
+ * are created and nothing is allocated unless the data is not a PNG image, in which case png::error is thrown.
+ */
+inline image_info probe(::std::span<const byte> bytes)
+{
+	image_info info;
+	if (!try_probe(bytes, info))
+	{
+		throw error("probe: not a PNG data stream or malformed IHDR");
+	}
+	return info;
+}
+
+/**
+ * \brief Returns the IHDR information of the PNG file named \a filename. Reads only the first probe_size bytes of the file.
+ */
+inline image_info probe(const char* filename)
+{
+	::std::FILE* file{::std::fopen(filename, "rb")};
+	if (!file)
+	{
+		throw std_error(filename);
+	}
+	::std::setvbuf(file, nullptr, _IONBF, 0);
+
+	::std::array<byte, probe_size> header;
+	size_t count{::std::fread(header.data(), 1, header.size(), file)};
+	::std::fclose(file);
+
+	image_info info;
+	if (!try_probe(::std::span(header.data(), count), info))
+	{
+		throw error(::std::string(filename) + ": not a PNG file or malformed IHDR");
+	}
+	return info;
+}
+
+inline image_info probe(const ::std::filesystem::path& path)
+{
+	return probe(path.string().c_str());
+}
+
+} // namespace png
+
+#endif // PNGPP_PROBE_HPP_INCLUDED
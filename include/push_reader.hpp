@@ -0,0 +1,306 @@
+/**********************************************************************************************************************************************\
+	Copyright© 2021 Mason DeRoss
+
+	Released under either the GNU All-permissive License or MIT license. You pick.
+
+	Copying and distribution of this file, with or without modification, are permitted in any medium without royalty,
+	provided the copyright notice and this notice are preserved. This file is offered as-is, without any warranty.
+
+	DESCRIPTION:
+		Push-mode (progressive) PNG decoding: feed byte fragments as they arrive, receive rows through callbacks.
+
+\**********************************************************************************************************************************************/
+#ifndef PNGPP_PUSH_READER_HPP_INCLUDED
+#define PNGPP_PUSH_READER_HPP_INCLUDED
+
+#pragma once
+
+#include <functional>
+#include <span>
+#include <stdexcept>
+
+#include "config.hpp"
+#include "error.hpp"
+#include "io_base.hpp"
+#include "streaming_base.hpp"
+
+namespace png
+{
+
+/**
+ * \brief The PNG push reader class template. The low-level progressive reading interface--use push_consumer to actually read images.
+ *
+ * Wraps the libpng progressive reader (\c png_set_progressive_read_fn / \c png_process_data). Instead of pulling bytes from a stream, the
+ * caller pushes fragments of any size with \c feed() as they arrive and libpng calls back into the \c handler whenever the info, a row or
+ * the end of the image has been decoded. The \c handler class should implement the following interface:
+ *
+ * \code
+ * class my_handler
+ * {
+ * public:
+ *		void on_info(png::push_reader<my_handler>&);
+ *		void on_row(png::push_reader<my_handler>&, png::byte* new_row, png::uint_32 row_number, int pass);
+ *		void on_end(png::push_reader<my_handler>&);
+ * };
+ * \endcode
+ *
+ * Exceptions thrown by the handler are turned into libpng errors and rethrown as png::error from \c feed().
+ *
+ * \see push_consumer, reader, io_base
+ */
+template<typename handler>
+class push_reader : public io_base
+{
+public:
+	explicit inline push_reader(handler& h) noexcept
+		: io_base(png_create_read_struct(PNG_LIBPNG_VER_STRING, static_cast<io_base*>(this), raise_error, 0)), m_handler(h)
+	{
+		png_set_progressive_read_fn(m_png.get(), this, info_callback, row_callback, end_callback);
+	}
+
+	inline ~push_reader() noexcept = default;
+
+	/**
+	 * \brief Hands the next fragment of the PNG data stream to the decoder. Any number of bytes, including zero, may be pushed at a time.
+	 */
+	inline void feed(::std::span<const byte> bytes)
+	{
+		if (setjmp(png_jmpbuf(m_png.get())))
+		{
+			throw error(m_error);
+		}
+		png_process_data(m_png.get(), m_info.get_png_info(), const_cast<byte*>(bytes.data()), bytes.size());
+	}
+
+	/**
+	 * \brief Returns \c true once the end of the image (IEND) has been decoded.
+	 */
+	inline constexpr bool is_done() const noexcept
+	{
+		return m_done;
+	}
+
+	/**
+	 * \brief Applies the transformations set so far. Call from \c on_info().
+	 */
+	inline void update_info() noexcept
+	{
+		m_info.update();
+	}
+
+	/**
+	 * \brief Merges the pixels of \a new_row delivered by this pass into \a row, see \c png_progressive_combine_row().
+	 */
+	inline void combine_row(byte* row, const byte* new_row) const noexcept
+	{
+		png_progressive_combine_row(m_png.get(), row, new_row);
+	}
+
+private:
+	static inline push_reader* get_reader(png_struct* png) noexcept
+	{
+		return static_cast<push_reader*>(png_get_progressive_ptr(png));
+	}
+
+	template<typename callback>
+	inline void dispatch(const callback& fn) noexcept
+	{
+		reset_error();
+		try
+		{
+			fn();
+		}
+		catch (const std::exception& error)
+		{
+			set_error(error.what());
+		}
+		catch (...)
+		{
+			assert(!"push_reader: caught something wrong");
+			set_error("push_reader: caught something wrong");
+		}
+		if (is_error())
+		{
+			raise_error();
+		}
+	}
+
+	static inline void info_callback(png_struct* png, png_info*) noexcept
+	{
+		auto rd{get_reader(png)};
+		rd->dispatch([rd]
+		{
+			rd->m_info.fetch();
+			rd->m_handler.on_info(*rd);
+		});
+	}
+
+	static inline void row_callback(png_struct* png, byte* new_row, uint32_t row_number, int pass) noexcept
+	{
+		auto rd{get_reader(png)};
+		rd->dispatch([rd, new_row, row_number, pass]
+		{
+			rd->m_handler.on_row(*rd, new_row, row_number, pass);
+		});
+	}
+
+	static inline void end_callback(png_struct* png, png_info*) noexcept
+	{
+		auto rd{get_reader(png)};
+		rd->m_done = true;
+		rd->dispatch([rd]
+		{
+			rd->m_handler.on_end(*rd);
+		});
+	}
+
+	handler& m_handler;
+	bool m_done{false};
+};
+
+/**
+ * \brief Push-mode pixel consumer class template.
+ *
+ * The push counterpart of the consumer class: instead of reading a whole stream in one call, the image data is pushed with \c feed() as it
+ * arrives (for example straight from the network) and rows are handed to the consumer as soon as they are decoded. No staging buffer
+ * for the whole upload is needed.
+ *
+ * Use the CRTP trick and implement \c get_next_row() and, optionally, \c reset() exactly as described for the consumer class:
+ *
+ * \code
+ * class row_sink : public png::push_consumer<png::rgb_pixel, row_sink>
+ * {
+ *		...
+ * };
+ *
+ * row_sink sink(info);
+ * while (!sink.is_done())
+ * {
+ *		sink.feed(socket.receive());
+ * }
+ * \endcode
+ *
+ * The io transformation, if any, must be set with \c set_transform() before the first fragment is fed. Interlaced images are only accepted
+ * when \c interlacing_supported is \c true; the rows of every pass are then combined into the row returned by \c get_next_row().
+ *
+ * \see consumer, push_reader
+ */
+template<typename pixel, typename pixcon, typename info_holder = def_image_info_holder, bool interlacing_supported = false>
+class push_consumer : public streaming_base<pixel, info_holder>
+{
+private:
+	push_consumer() = delete;
+
+	push_consumer(const push_consumer&) = delete;
+	push_consumer(push_consumer&&) = delete;
+
+	push_consumer& operator=(const push_consumer&) = delete;
+	push_consumer& operator=(push_consumer&&) = delete;
+
+	friend class push_reader<push_consumer>;
+
+protected:
+	using base = streaming_base<pixel, info_holder>;
+
+	/**
+	 * \brief Constructs a push_consumer object using passed image_info object to store image information.
+	 */
+	explicit inline push_consumer(image_info& info) noexcept : base(info), m_reader(*this) {}
+
+public:
+	using traits = pixel_traits<pixel>;
+
+	inline ~push_consumer() noexcept = default;
+
+	/**
+	 * \brief Sets the io transformation applied once the image info has been decoded.
+	 */
+	template<typename transformation>
+	inline void set_transform(const transformation& transform)
+	{
+		m_transform = transform;
+	}
+
+	/**
+	 * \brief Decodes the next fragment of the PNG data stream, delivering every row it completes.
+	 */
+	inline void feed(::std::span<const byte> bytes)
+	{
+		m_reader.feed(bytes);
+	}
+
+	inline constexpr bool is_done() const noexcept
+	{
+		return m_reader.is_done();
+	}
+
+private:
+	inline void on_info(push_reader<push_consumer>& rd)
+	{
+		if (m_transform)
+		{
+			m_transform(rd);
+		}
+
+		if constexpr (__little_endian)
+		{
+			if constexpr (png_read_swap_supported)
+			{
+				if (pixel_traits<pixel>::get_bit_depth() == 16)
+				{
+					rd.set_swap();
+				}
+			}
+			else
+			{
+				throw error("Cannot read 16-bit image: recompile with PNG_READ_SWAP_SUPPORTED.");
+			}
+		}
+
+		if (rd.get_interlace_type() != interlace_none)
+		{
+			if constexpr (png_read_interlacing_supported && interlacing_supported)
+			{
+				rd.set_interlace_handling();
+			}
+			else
+			{
+				throw error("Cannot push-read interlaced image: consumer does not support it.");
+			}
+		}
+
+		rd.update_info();
+		if (rd.get_color_type() != traits::get_color_type() || rd.get_bit_depth() != traits::get_bit_depth())
+		{
+			throw std::logic_error("color type and/or bit depth mismatch in png::push_consumer::on_info()");
+		}
+
+		this->get_info() = rd.get_image_info();
+	}
+
+	inline void on_row(push_reader<push_consumer>& rd, byte* new_row, uint32_t row_number, int pass)
+	{
+		auto pixel_con{static_cast<pixcon*>(this)};
+		if (pass != m_pass)
+		{
+			m_pass = pass;
+			pixel_con->reset(static_cast<size_t>(pass));
+		}
+
+		// libpng passes no data for rows the current interlace pass does not touch
+		if (new_row)
+		{
+			rd.combine_row(pixel_con->get_next_row(row_number), new_row);
+		}
+	}
+
+	inline constexpr void on_end(push_reader<push_consumer>&) const noexcept {}
+
+	push_reader<push_consumer> m_reader;
+	::std::function<void(io_base&)> m_transform;
+	int m_pass{-1};
+};
+
+} // namespace png
+
+#endif // PNGPP_PUSH_READER_HPP_INCLUDED
@@ -34,11 +34,23 @@
 #pragma once
 
 //#include <cassert>
+#include <concepts>
 #include "io_base.hpp"
+#include "decode_options.hpp"
 
 namespace png
 {
 
+/**
+ * \brief The minimum interface of an input stream the reader class can work with.
+ */
+template<typename istream>
+concept input_stream = requires(istream& stream, char* data, size_t length)
+{
+	stream.read(data, length);
+	{ stream.good() } -> ::std::convertible_to<bool>;
+};
+
 /**
  * \brief The PNG reader class template. This is the low-level reading interface--use image class or consumer class to actually read images.
  *
@@ -90,13 +102,31 @@ public:
 
 	/**
 	 * \brief Reads info about PNG image.
+	 *
+	 * The checks in \a options that are turned off stay off for the rest of the image, see decode_options.
 	 */
-	inline constexpr void read_info()
+	inline constexpr void read_info(const decode_options& options = decode_options())
 	{
 		if (setjmp(png_jmpbuf(m_png.get())))
 		{
 			throw error(m_error);
 		}
+		if (!options.verify_crc)
+		{
+			png_set_crc_action(m_png.get(), PNG_CRC_QUIET_USE, PNG_CRC_QUIET_USE);
+		}
+#if defined(PNG_IGNORE_ADLER32)
+		if (!options.verify_adler)
+		{
+			png_set_option(m_png.get(), PNG_IGNORE_ADLER32, PNG_OPTION_ON);
+		}
+#endif
+#if defined(PNG_SKIP_sRGB_CHECK_PROFILE)
+		if (!options.check_profiles)
+		{
+			png_set_option(m_png.get(), PNG_SKIP_sRGB_CHECK_PROFILE, PNG_OPTION_ON);
+		}
+#endif
 		m_info.read();
 	}
 
@@ -112,6 +142,32 @@ public:
 		png_read_row(m_png.get(), bytes, 0);
 	}
 
+	/**
+	 * \brief Reads \a count rows of image data at a time, into \a rows[0] to \a rows[count - 1].
+	 *
+	 * One \c setjmp() and one libpng call for the whole band rather than one of each per row.
+	 */
+	inline void read_rows(byte** rows, size_t count)
+	{
+		if (setjmp(png_jmpbuf(m_png.get())))
+		{
+			throw error(m_error);
+		}
+		png_read_rows(m_png.get(), rows, 0, static_cast<png_uint_32>(count));
+	}
+
+	/**
+	 * \brief Reads the whole image, every interlace pass, into the rows \a rows points to, one per image row.
+	 */
+	inline void read_image(byte** rows)
+	{
+		if (setjmp(png_jmpbuf(m_png.get())))
+		{
+			throw error(m_error);
+		}
+		png_read_image(m_png.get(), rows);
+	}
+
 	/**
 	 * \brief Reads ending info about PNG image.
 	 */
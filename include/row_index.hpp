@@ -0,0 +1,551 @@
+/**********************************************************************************************************************************************\
+	Copyright© 2021 Mason DeRoss
+
+	Released under either the GNU All-permissive License or MIT license. You pick.
+
+	Copying and distribution of this file, with or without modification, are permitted in any medium without royalty,
+	provided the copyright notice and this notice are preserved. This file is offered as-is, without any warranty.
+
+	DESCRIPTION:
+		Random access to the rows of a PNG image through inflate checkpoints, zran style, with a sidecar file to keep them in.
+
+\**********************************************************************************************************************************************/
+#ifndef PNGPP_ROW_INDEX_HPP_INCLUDED
+#define PNGPP_ROW_INDEX_HPP_INCLUDED
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <span>
+#include <string>
+#include <vector>
+
+extern "C"
+{
+	#include <zlib.h>
+}
+
+#include "types.hpp"
+#include "error.hpp"
+#include "chunk.hpp"
+#include "chunk_scanner.hpp"
+#include "filter.hpp"
+#include "split_index.hpp"
+#include "zstream.hpp"
+
+namespace png
+{
+
+namespace detail
+{
+
+/**
+ * \brief Collects inflated bytes into rows and unfilters each one as soon as it is complete.
+ */
+class row_assembler
+{
+public:
+	explicit inline row_assembler(const image_info& info)
+		: m_rowbytes(info.get_rowbytes()), m_bpp(get_filter_bpp(info)), m_row(m_rowbytes + 1), m_prev(m_rowbytes + 1) {}
+
+	/**
+	 * \brief Continues at row \a pos with \a prev as the reconstructed row above it (empty for zeros) and \a partial already collected.
+	 */
+	inline void restore(size_t pos, ::std::span<const byte> prev, ::std::span<const byte> partial)
+	{
+		m_pos = pos;
+		::std::fill(m_prev.begin(), m_prev.end(), byte{0});
+		::std::copy(prev.begin(), prev.end(), m_prev.begin() + 1);
+		::std::copy(partial.begin(), partial.end(), m_row.begin());
+		m_filled = partial.size();
+	}
+
+	/**
+	 * \brief Adds \a size inflated bytes, calling \a on_row(pos, row) for every row completed. Stops early and returns \c false as soon as
+	 * \a on_row does.
+	 */
+	template<typename callback>
+	inline bool push(const byte* data, size_t size, const callback& on_row)
+	{
+		while (size > 0)
+		{
+			const size_t count{::std::min(size, m_row.size() - m_filled)};
+			::std::copy(data, data + count, m_row.begin() + m_filled);
+			m_filled += count;
+			data += count;
+			size -= count;
+
+			if (m_filled == m_row.size())
+			{
+				unfilter_row(m_row[0], m_row.data() + 1, m_prev.data() + 1, m_rowbytes, m_bpp);
+				m_row.swap(m_prev);
+				m_filled = 0;
+				if (!on_row(m_pos++, static_cast<const byte*>(m_prev.data() + 1)))
+				{
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	inline size_t get_pos() const noexcept
+	{
+		return m_pos;
+	}
+
+	/**
+	 * \brief The reconstructed row above the current one.
+	 */
+	inline ::std::span<const byte> get_prev() const noexcept
+	{
+		return ::std::span(m_prev).subspan(1);
+	}
+
+	/**
+	 * \brief The filtered bytes of the current row collected so far.
+	 */
+	inline ::std::span<const byte> get_partial() const noexcept
+	{
+		return ::std::span(m_row).first(m_filled);
+	}
+
+private:
+	size_t m_rowbytes;
+	size_t m_bpp;
+	::std::vector<byte> m_row;				// filter type byte and row
+	::std::vector<byte> m_prev;
+	size_t m_filled{0};
+	size_t m_pos{0};
+};
+
+} // namespace detail
+
+/**
+ * \brief An index of inflate checkpoints for decoding any band of rows of a non-interlaced PNG image without inflating what is above it.
+ *
+ * Built once with build(), which inflates the whole image and, at the first deflate block boundary after every \c spacing rows, snapshots
+ * what is needed to resume there: the input position down to the bit, the 32K of inflated data in front of it, the reconstructed row above
+ * and the part of the current row already inflated. read_rows() then starts from the closest checkpoint above the requested band. The
+ * index can be kept next to the image with save() and load():
+ *
+ * \code
+ * png::mapped_file file("huge.png");
+ * auto chunks{png::scan_chunks(file.get_bytes())};
+ * auto index{png::row_index::build(chunks)};
+ * index.save("huge.png.idx");
+ * ...
+ * index.read_rows(chunks, 39000, 256, [&](size_t pos){ return tile.data() + (pos - 39000) * chunks.info.get_rowbytes(); });
+ * \endcode
+ *
+ * Rows come out the way the reader delivers them without transforms: packed as in the file, 16-bit samples in host byte order.
+ *
+ * \see decode_split()
+ */
+class row_index
+{
+public:
+	/**
+	 * \brief The state needed to resume inflating the image data at one point.
+	 */
+	struct checkpoint
+	{
+		uint64_t in{0};						// zlib stream offset of the first byte to feed
+		uint64_t out{0};					// number of inflated bytes in front of this point
+		int bits{0};						// bits of the byte at in - 1 that still belong to the next block
+		::std::vector<byte> window;			// up to 32K of inflated bytes in front of this point
+		::std::vector<byte> prev;			// the reconstructed row above the current one, empty at the first row
+		::std::vector<byte> partial;		// the filtered bytes of the current row in front of this point
+	};
+
+	/**
+	 * \brief The magic number at the start of a sidecar file.
+	 */
+	static inline constexpr const ::std::array<byte, 8> magic{'P', 'N', 'G', '+', '+', 'I', 'D', 'X'};
+
+	inline row_index() noexcept = default;
+
+	/**
+	 * \brief Inflates the image data of \a chunks once and records a checkpoint about every \a spacing rows.
+	 */
+	static inline row_index build(const chunk_index& chunks, size_t spacing = 256)
+	{
+		row_index index;
+		index.set_image(chunks);
+		index.m_spacing = static_cast<uint32_t>(::std::max<size_t>(spacing, 1));
+		index.m_points.push_back({2, 0, 0, {}, {}, {}});
+
+		const detail::idat_stream stream(chunks);
+		const size_t stride{chunks.info.get_rowbytes() + 1};
+		detail::inflate_stream inflater(-15);
+		detail::row_assembler rows(chunks.info);
+		::std::vector<byte> window(32768);
+		size_t window_pos{0};
+		uint64_t in{2};
+		uint64_t out{0};
+		uint64_t next{index.m_spacing * stride};
+
+		stream.for_each(2, stream.size() - 4, [&](::std::span<const byte> piece)
+		{
+			while (!piece.empty() && !inflater.is_end())
+			{
+				const size_t size{piece.size()};
+				const size_t produced{inflater.inflate(piece, ::std::span(window).subspan(window_pos), Z_BLOCK)};
+				rows.push(window.data() + window_pos, produced, [](size_t, const byte*){ return true; });
+				window_pos = (window_pos + produced) % window.size();
+				in += size - piece.size();
+				out += produced;
+
+				if (inflater.is_block_boundary() && out >= next)
+				{
+					checkpoint point{in, out, inflater.get_block_bits(), {}, {}, {}};
+					if (out < window.size())
+					{
+						point.window.assign(window.begin(), window.begin() + static_cast<::std::ptrdiff_t>(out));
+					}
+					else
+					{
+						point.window.assign(window.begin() + static_cast<::std::ptrdiff_t>(window_pos), window.end());
+						point.window.insert(point.window.end(), window.begin(), window.begin() + static_cast<::std::ptrdiff_t>(window_pos));
+					}
+					if (rows.get_pos() > 0)
+					{
+						point.prev.assign(rows.get_prev().begin(), rows.get_prev().end());
+					}
+					point.partial.assign(rows.get_partial().begin(), rows.get_partial().end());
+					index.m_points.push_back(::std::move(point));
+					next = (rows.get_pos() + index.m_spacing) * stride;
+				}
+			}
+			return !inflater.is_end();
+		});
+
+		if (out != stride * chunks.info.get_height())
+		{
+			throw error("row_index: image data does not match the image size");
+		}
+		return index;
+	}
+
+	/**
+	 * \brief Decodes rows [first, first + count) of the image in \a chunks, which must be the one the index was built from.
+	 *
+	 * \a get_row(pos) gives the address row \c pos is stored at.
+	 */
+	template<typename row_target>
+	inline void read_rows(const chunk_index& chunks, size_t first, size_t count, const row_target& get_row) const
+	{
+		check_image(chunks);
+		if (count == 0)
+		{
+			return;
+		}
+		if (first + count > m_height)
+		{
+			throw error("row_index: rows out of range");
+		}
+
+		const size_t stride{chunks.info.get_rowbytes() + 1};
+		auto point{::std::upper_bound(m_points.begin(), m_points.end(), first,
+			[stride](size_t row, const checkpoint& p){ return row < p.out / stride; }) - 1};
+		if (!is_valid(*point))
+		{
+			throw error("row_index: corrupt checkpoint");
+		}
+
+		const detail::idat_stream stream(chunks);
+		detail::inflate_stream inflater(-15);
+		byte last_byte{0};
+		if (point->bits)
+		{
+			stream.copy(point->in - 1, 1, &last_byte);
+		}
+		inflater.resume(point->bits, last_byte, point->window);
+
+		detail::row_assembler rows(chunks.info);
+		rows.restore(static_cast<size_t>(point->out / stride), point->prev, point->partial);
+
+		const int bit_depth{chunks.info.get_bit_depth()};
+		const size_t rowbytes{chunks.info.get_rowbytes()};
+		auto on_row = [&](size_t pos, const byte* row)
+		{
+			if (pos >= first)
+			{
+				detail::store_row(row, reinterpret_cast<byte*>(get_row(pos)), rowbytes, bit_depth);
+			}
+			return pos + 1 < first + count;
+		};
+
+		::std::vector<byte> buffer(32768);
+		bool more{true};
+		stream.for_each(point->in, stream.size() - 4, [&](::std::span<const byte> piece)
+		{
+			while (more && !piece.empty() && !inflater.is_end())
+			{
+				const size_t produced{inflater.inflate(piece, buffer)};
+				more = rows.push(buffer.data(), produced, on_row);
+			}
+			return more && !inflater.is_end();
+		});
+		if (more)
+		{
+			throw error("row_index: image data ends too early");
+		}
+	}
+
+	/**
+	 * \brief Writes the index to the sidecar file \a filename. The snapshots are deflated.
+	 */
+	inline void save(const char* filename) const
+	{
+		::std::ofstream file(filename, ::std::ios::binary);
+		if (!file.is_open())
+		{
+			throw std_error(filename);
+		}
+		file.exceptions(::std::ios::badbit | ::std::ios::failbit);
+
+		::std::vector<byte> header(magic.begin(), magic.end());
+		put_be32(header, version);
+		put_be32(header, m_width);
+		put_be32(header, m_height);
+		header.push_back(static_cast<byte>(m_bit_depth));
+		header.push_back(static_cast<byte>(m_color_type));
+		put_be64(header, m_zlib_size);
+		put_be32(header, m_adler);
+		put_be32(header, m_spacing);
+		put_be32(header, static_cast<uint32_t>(m_points.size()));
+		write_bytes(file, header);
+
+		::std::vector<byte> snapshot;
+		::std::vector<byte> packed;
+		for (const auto& point : m_points)
+		{
+			snapshot.assign(point.window.begin(), point.window.end());
+			snapshot.insert(snapshot.end(), point.prev.begin(), point.prev.end());
+			snapshot.insert(snapshot.end(), point.partial.begin(), point.partial.end());
+
+			uLongf size{::compressBound(static_cast<uLong>(snapshot.size()))};
+			packed.resize(size);
+			if (::compress2(packed.data(), &size, snapshot.data(), static_cast<uLong>(snapshot.size()), Z_BEST_SPEED) != Z_OK)
+			{
+				throw error("row_index: compress2() failed");
+			}
+			packed.resize(size);
+
+			::std::vector<byte> entry;
+			put_be64(entry, point.in);
+			put_be64(entry, point.out);
+			entry.push_back(static_cast<byte>(point.bits));
+			put_be32(entry, static_cast<uint32_t>(point.window.size()));
+			put_be32(entry, static_cast<uint32_t>(point.prev.size()));
+			put_be32(entry, static_cast<uint32_t>(point.partial.size()));
+			put_be32(entry, static_cast<uint32_t>(packed.size()));
+			write_bytes(file, entry);
+			write_bytes(file, packed);
+		}
+	}
+
+	inline void save(const ::std::string& filename) const
+	{
+		save(filename.c_str());
+	}
+
+	/**
+	 * \brief Reads an index written by save(). read_rows() checks that it belongs to the image it is used with.
+	 */
+	static inline row_index load(const char* filename)
+	{
+		::std::ifstream file(filename, ::std::ios::binary);
+		if (!file.is_open())
+		{
+			throw std_error(filename);
+		}
+		file.exceptions(::std::ios::badbit);
+
+		::std::array<byte, 8 + 4 * 3 + 2 + 8 + 4 * 3> header;
+		read_bytes(file, header);
+		if (!::std::equal(magic.begin(), magic.end(), header.begin()) || load_be32(header.data() + 8) != version)
+		{
+			throw error(::std::string(filename) + ": not a png++ row index");
+		}
+
+		row_index index;
+		const byte* field{header.data() + 12};
+		index.m_width = load_be32(field);
+		index.m_height = load_be32(field + 4);
+		index.m_bit_depth = field[8];
+		index.m_color_type = field[9];
+		index.m_zlib_size = (uint64_t{load_be32(field + 10)} << 32) | load_be32(field + 14);
+		index.m_adler = load_be32(field + 18);
+		index.m_spacing = load_be32(field + 22);
+		const uint32_t count{load_be32(field + 26)};
+		const size_t rowbytes{index.get_rowbytes()};
+
+		::std::vector<byte> packed;
+		::std::vector<byte> snapshot;
+		for (uint32_t i{0}; i < count; ++i)
+		{
+			::std::array<byte, 8 + 8 + 1 + 4 * 4> entry;
+			read_bytes(file, entry);
+
+			checkpoint point;
+			point.in = (uint64_t{load_be32(entry.data())} << 32) | load_be32(entry.data() + 4);
+			point.out = (uint64_t{load_be32(entry.data() + 8)} << 32) | load_be32(entry.data() + 12);
+			point.bits = entry[16] & 7;
+			const size_t window_size{load_be32(entry.data() + 17)};
+			const size_t prev_size{load_be32(entry.data() + 21)};
+			const size_t partial_size{load_be32(entry.data() + 25)};
+			const size_t packed_size{load_be32(entry.data() + 29)};
+
+			// the sizes come from the file: check them before allocating anything
+			if (window_size > 32768 || (prev_size != 0 && prev_size != rowbytes) || partial_size > rowbytes
+				|| packed_size > ::compressBound(static_cast<uLong>(window_size + prev_size + partial_size)))
+			{
+				throw error(::std::string(filename) + ": corrupt row index");
+			}
+			packed.resize(packed_size);
+			read_bytes(file, packed);
+			snapshot.resize(window_size + prev_size + partial_size);
+			uLongf size{static_cast<uLongf>(snapshot.size())};
+			if (::uncompress(snapshot.data(), &size, packed.data(), static_cast<uLong>(packed.size())) != Z_OK || size != snapshot.size())
+			{
+				throw error(::std::string(filename) + ": corrupt row index");
+			}
+
+			auto at{snapshot.begin()};
+			point.window.assign(at, at + static_cast<::std::ptrdiff_t>(window_size));
+			at += static_cast<::std::ptrdiff_t>(window_size);
+			point.prev.assign(at, at + static_cast<::std::ptrdiff_t>(prev_size));
+			at += static_cast<::std::ptrdiff_t>(prev_size);
+			point.partial.assign(at, snapshot.end());
+
+			if (!index.is_valid(point) || (!index.m_points.empty() && point.out <= index.m_points.back().out))
+			{
+				throw error(::std::string(filename) + ": corrupt row index");
+			}
+			index.m_points.push_back(::std::move(point));
+		}
+		if (index.m_points.empty() || index.m_points.front().out != 0)
+		{
+			throw error(::std::string(filename) + ": corrupt row index");
+		}
+		return index;
+	}
+
+	static inline row_index load(const ::std::string& filename)
+	{
+		return load(filename.c_str());
+	}
+
+	inline const ::std::vector<checkpoint>& get_checkpoints() const noexcept
+	{
+		return m_points;
+	}
+
+	inline size_t get_spacing() const noexcept
+	{
+		return m_spacing;
+	}
+
+private:
+	static inline constexpr const uint32_t version{1};
+
+	static inline void put_be32(::std::vector<byte>& out, uint32_t value)
+	{
+		::std::array<byte, 4> bytes;
+		store_be32(bytes.data(), value);
+		out.insert(out.end(), bytes.begin(), bytes.end());
+	}
+
+	static inline void put_be64(::std::vector<byte>& out, uint64_t value)
+	{
+		put_be32(out, static_cast<uint32_t>(value >> 32));
+		put_be32(out, static_cast<uint32_t>(value));
+	}
+
+	static inline void write_bytes(::std::ofstream& file, ::std::span<const byte> bytes)
+	{
+		file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<::std::streamsize>(bytes.size()));
+	}
+
+	static inline void read_bytes(::std::ifstream& file, ::std::span<byte> bytes)
+	{
+		file.read(reinterpret_cast<char*>(bytes.data()), static_cast<::std::streamsize>(bytes.size()));
+		if (file.gcount() != static_cast<::std::streamsize>(bytes.size()))
+		{
+			throw error("row_index: sidecar file is truncated");
+		}
+	}
+
+	static inline uint32_t get_adler(const detail::idat_stream& stream)
+	{
+		::std::array<byte, 4> trailer;
+		stream.copy(stream.size() - 4, 4, trailer.data());
+		return load_be32(trailer.data());
+	}
+
+	inline void set_image(const chunk_index& chunks)
+	{
+		if (chunks.info.get_interlace_type() != interlace_none)
+		{
+			throw error("row_index: interlaced images are not supported");
+		}
+		const detail::idat_stream stream(chunks);
+		if (stream.size() < 6)
+		{
+			throw error("row_index: no image data");
+		}
+		m_width = chunks.info.get_width();
+		m_height = chunks.info.get_height();
+		m_bit_depth = chunks.info.get_bit_depth();
+		m_color_type = chunks.info.get_color_type();
+		m_zlib_size = stream.size();
+		m_adler = get_adler(stream);
+	}
+
+	inline size_t get_rowbytes() const noexcept
+	{
+		image_info info;
+		info.set_width(m_width);
+		info.set_color_type(static_cast<color_type>(m_color_type));
+		info.set_bit_depth(m_bit_depth);
+		return info.get_rowbytes();
+	}
+
+	/**
+	 * \brief Whether \a point can be resumed from: inside the image data, with a row above and a partial row that fit a row.
+	 */
+	inline bool is_valid(const checkpoint& point) const noexcept
+	{
+		const size_t rowbytes{get_rowbytes()};
+		return point.in <= m_zlib_size && (point.bits == 0 || point.in > 0) && point.out / (rowbytes + 1) < m_height
+			&& point.window.size() <= 32768 && (point.prev.empty() || point.prev.size() == rowbytes) && point.partial.size() <= rowbytes;
+	}
+
+	inline void check_image(const chunk_index& chunks) const
+	{
+		const detail::idat_stream stream(chunks);
+		if (m_points.empty() || m_width != chunks.info.get_width() || m_height != chunks.info.get_height()
+			|| m_bit_depth != chunks.info.get_bit_depth() || m_color_type != chunks.info.get_color_type()
+			|| chunks.info.get_interlace_type() != interlace_none || m_zlib_size != stream.size() || m_adler != get_adler(stream))
+		{
+			throw error("row_index: index does not belong to this image");
+		}
+	}
+
+	uint32_t m_width{0};
+	uint32_t m_height{0};
+	int m_bit_depth{0};
+	int m_color_type{0};
+	uint64_t m_zlib_size{0};
+	uint32_t m_adler{0};
+	uint32_t m_spacing{0};
+	::std::vector<checkpoint> m_points;
+};
+
+} // namespace png
+
+#endif // PNGPP_ROW_INDEX_HPP_INCLUDED
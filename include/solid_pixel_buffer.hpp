@@ -89,7 +89,7 @@ protected:
 	static_assert(pixel_traits_t::bit_depth % CHAR_BIT == 0, "bit_depth should consist of integer number of bytes");
 	static_assert(sizeof(pixel) * CHAR_BIT == pixel_traits_t::channels * pixel_traits_t::bit_depth, "pixel type should contain channels data only");
 
-private:
+public:
 
 	/**
 	 * \brief Constructs an empty 0x0 pixel buffer object.
@@ -97,11 +97,11 @@ private:
 	inline constexpr solid_pixel_buffer() noexcept = default;
 
 	/**
-	 * \brief Constructs an empty pixel buffer object.
+	 * \brief Constructs a pixel buffer object of specified width and height, filled with value of \a pixel().
 	 */
-	inline constexpr solid_pixel_buffer(uint32_t width, uint32_t height) noexcept : m_width{width}, m_height{height}, m_stride{m_width * bytes_per_pixel}
+	inline constexpr solid_pixel_buffer(uint32_t width, uint32_t height)
 	{
-		m_bytes.reserve(height * m_stride);
+		resize(width, height);
 	}
 
 	inline constexpr ~solid_pixel_buffer() noexcept = default;
@@ -129,7 +129,7 @@ private:
 	 *
 	 * If new width or height is greater than the original, expanded pixels are filled with value of \a pixel().
 	 */
-	inline constexpr void resize(uint32_t width, uint32_t height) noexcept
+	inline constexpr void resize(uint32_t width, uint32_t height)
 	{
 		m_width = width;
 		m_height = height;
@@ -142,7 +142,7 @@ private:
 	 *
 	 * Checks the index before returning a row: an instance of std::out_of_range is thrown if \c index is greater than \c height.
 	 */
-	inline constexpr row_access get_row(size_t index) noexcept
+	inline constexpr row_access get_row(size_t index)
 	{
 		return reinterpret_cast<row_access>(&m_bytes.at(index * m_stride));
 	}
@@ -152,9 +152,9 @@ private:
 	 *
 	 * The checking version.
 	 */
-	inline constexpr row_const_access get_row(size_t index) const noexcept
+	inline constexpr row_const_access get_row(size_t index) const
 	{
-		return static_cast<row_const_access>(&m_bytes.at(index * m_stride));
+		return reinterpret_cast<row_const_access>(&m_bytes.at(index * m_stride));
 	}
 
 	/**
@@ -162,7 +162,7 @@ private:
 	 */
 	inline constexpr row_access operator[](size_t index) noexcept
 	{
-		return static_cast<row_access>(&m_bytes[index * m_stride]);
+		return reinterpret_cast<row_access>(&m_bytes[index * m_stride]);
 	}
 
 	/**
@@ -170,13 +170,13 @@ private:
 	 */
 	inline constexpr row_const_access operator[](size_t index) const noexcept
 	{
-		return static_cast<row_const_access>(&m_bytes[index * m_stride]);
+		return reinterpret_cast<row_const_access>(&m_bytes[index * m_stride]);
 	}
 
 	/**
 	 * \brief Replaces the row at specified index.
 	 */
-	inline constexpr void put_row(size_t index, row_const_access r) noexcept
+	inline constexpr void put_row(size_t index, row_const_access r)
 	{
 		auto row{get_row(index)};
 		/*for (uint32_t i = 0; i < m_width; ++i)
@@ -190,7 +190,7 @@ private:
 	/**
 	 * \brief Returns a pixel at (x,y) position.
 	 */
-	inline constexpr pixel get_pixel(uint64_t x, uint64_t y) const noexcept
+	inline constexpr pixel get_pixel(uint64_t x, uint64_t y) const
 	{
 		size_t index{(y * m_width + x) * bytes_per_pixel};
 		return *(reinterpret_cast<const pixel*>(&m_bytes.at(index)));
@@ -199,12 +199,43 @@ private:
 	/**
 	 * \brief Replaces a pixel at (x,y) position.
 	 */
-	inline constexpr void set_pixel(uint64_t x, uint64_t y, pixel p) noexcept
+	inline constexpr void set_pixel(uint64_t x, uint64_t y, pixel p)
 	{
 		size_t index{(y * m_width + x) * bytes_per_pixel};
 		*(reinterpret_cast<pixel*>(&m_bytes.at(index))) = p;
 	}
 
+	/**
+	 * \brief Returns the number of bytes between the starts of two consecutive rows, which is also the size of a row.
+	 */
+	inline constexpr uint64_t get_stride() const noexcept
+	{
+		return m_stride;
+	}
+
+	/**
+	 * \brief Returns the starting address of every row, for libpng calls that take the whole image at once (see reader::read_image()).
+	 */
+	inline ::std::vector<byte*> get_row_pointers()
+	{
+		::std::vector<byte*> rows(m_height);
+		for (size_t i{0}; i < rows.size(); ++i)
+		{
+			rows[i] = m_bytes.data() + i * m_stride;
+		}
+		return rows;
+	}
+
+	/**
+	 * \brief Returns the underlying byte buffer, for decoders that fill it in place (see decode_native_whole()).
+	 *
+	 * Its size must be \c height * \c stride again by the time the pixel buffer is used.
+	 */
+	inline constexpr ::std::vector<byte>& get_storage() noexcept
+	{
+		return m_bytes;
+	}
+
 	/**
 	 * \brief Provides easy constant read access to underlying byte-buffer.
 	 */
@@ -0,0 +1,84 @@
+/**********************************************************************************************************************************************\
+	Copyright© 2021 Mason DeRoss
+
+	Released under either the GNU All-permissive License or MIT license. You pick.
+
+	Copying and distribution of this file, with or without modification, are permitted in any medium without royalty,
+	provided the copyright notice and this notice are preserved. This file is offered as-is, without any warranty.
+
+	DESCRIPTION:
+		Input stream over a caller owned byte buffer, usable as the input stream of png::reader.
+
+\**********************************************************************************************************************************************/
+#ifndef PNGPP_SPAN_ISTREAM_HPP_INCLUDED
+#define PNGPP_SPAN_ISTREAM_HPP_INCLUDED
+
+#pragma once
+
+#include <span>
+#include <cstring>
+
+#include "types.hpp"
+
+namespace png
+{
+
+/**
+ * \brief Reads PNG data straight out of a memory buffer owned by the caller.
+ *
+ * Implements the \c istream interface expected by the reader class. Unlike wrapping the buffer in a \c std::istringstream, nothing is copied
+ * up front: each \c read() copies the requested bytes from the caller's buffer directly into the libpng buffer.
+ *
+ * The buffer must outlive the span_istream object.
+ *
+ * \see reader, image, consumer
+ */
+class span_istream
+{
+public:
+	explicit inline constexpr span_istream(::std::span<const byte> bytes) noexcept : m_bytes(bytes) {}
+
+	/**
+	 * \brief Copies the next \a length bytes into \a data. Reading past the end of the buffer clears the good() flag.
+	 */
+	inline void read(char* data, size_t length) noexcept
+	{
+		if (length > m_bytes.size() - m_pos)
+		{
+			m_good = false;
+			length = m_bytes.size() - m_pos;
+		}
+		if (length > 0)
+		{
+			::std::memcpy(data, m_bytes.data() + m_pos, length);
+			m_pos += length;
+		}
+	}
+
+	inline constexpr bool good() const noexcept
+	{
+		return m_good;
+	}
+
+	/**
+	 * \brief Returns the number of bytes consumed so far.
+	 */
+	inline constexpr size_t tell() const noexcept
+	{
+		return m_pos;
+	}
+
+	inline constexpr ::std::span<const byte> get_bytes() const noexcept
+	{
+		return m_bytes;
+	}
+
+private:
+	::std::span<const byte> m_bytes;
+	size_t m_pos{0};
+	bool m_good{true};
+};
+
+} // namespace png
+
+#endif // PNGPP_SPAN_ISTREAM_HPP_INCLUDED
@@ -0,0 +1,334 @@
+/**********************************************************************************************************************************************\
+	Copyright© 2021 Mason DeRoss
+
+	Released under either the GNU All-permissive License or MIT license. You pick.
+
+	Copying and distribution of this file, with or without modification, are permitted in any medium without royalty,
+	provided the copyright notice and this notice are preserved. This file is offered as-is, without any warranty.
+
+	DESCRIPTION:
+		The spIX chunk, which marks where independently decodable strips start in the IDAT stream, and a parallel decoder for it.
+
+\**********************************************************************************************************************************************/
+#ifndef PNGPP_SPLIT_INDEX_HPP_INCLUDED
+#define PNGPP_SPLIT_INDEX_HPP_INCLUDED
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <span>
+#include <thread>
+#include <vector>
+
+extern "C"
+{
+	#include <zlib.h>
+}
+
+#include "config.hpp"
+#include "types.hpp"
+#include "error.hpp"
+#include "chunk.hpp"
+#include "checksum.hpp"
+#include "chunk_scanner.hpp"
+#include "filter.hpp"
+#include "pixel_traits.hpp"
+#include "zstream.hpp"
+#include "worker_threads.hpp"
+
+namespace png
+{
+
+/**
+ * \brief png++'s private chunk listing the split points of a file written with strip_options::split_points.
+ *
+ * Ancillary, private and unsafe to copy: it describes the IDAT layout, so editors that rewrite IDAT must drop it. The data is a sequence of
+ * 12-byte entries, one per strip, each a big-endian 32-bit first row followed by the big-endian 64-bit offset of the strip in the zlib
+ * stream (the concatenated IDAT data).
+ */
+inline constexpr const chunk_type chunk_type_spIX{make_chunk_type("spIX")};
+
+/**
+ * \brief Where an independently decodable strip of rows starts.
+ */
+struct split_point
+{
+	uint32_t first_row{0};
+	uint64_t offset{0};						// in the zlib stream, the first strip starts right after the 2-byte header
+};
+
+/**
+ * \brief Returns the data of the spIX chunk describing \a points.
+ */
+inline ::std::vector<byte> make_split_index(::std::span<const split_point> points)
+{
+	::std::vector<byte> data(points.size() * 12);
+	byte* entry{data.data()};
+	for (const auto& point : points)
+	{
+		store_be32(entry, point.first_row);
+		store_be32(entry + 4, static_cast<uint32_t>(point.offset >> 32));
+		store_be32(entry + 8, static_cast<uint32_t>(point.offset));
+		entry += 12;
+	}
+	return data;
+}
+
+/**
+ * \brief Returns the split points recorded in \a index, or nothing if there is no spIX chunk or it does not fit the image.
+ */
+inline ::std::vector<split_point> find_split_points(const chunk_index& index)
+{
+	const chunk_record* spix{index.find(chunk_type_spIX)};
+	if (!spix || spix->chunk.data.empty() || spix->chunk.data.size() % 12 != 0 || index.info.get_interlace_type() != interlace_none)
+	{
+		return {};
+	}
+
+	uint64_t zlib_size{0};
+	for (const auto& run : index.idat_runs)
+	{
+		zlib_size += run.data_size;
+	}
+
+	::std::vector<split_point> points;
+	for (auto data{spix->chunk.data}; !data.empty(); data = data.subspan(12))
+	{
+		const split_point point{load_be32(data.data()), (uint64_t{load_be32(data.data() + 4)} << 32) | load_be32(data.data() + 8)};
+		const bool ordered{points.empty() ? point.first_row == 0 && point.offset == 2
+			: point.first_row > points.back().first_row && point.offset > points.back().offset};
+		if (!ordered || point.first_row >= index.info.get_height() || point.offset + 4 >= zlib_size)
+		{
+			return {};
+		}
+		points.push_back(point);
+	}
+	return points;
+}
+
+namespace detail
+{
+
+/**
+ * \brief Returns \c true if the image data in \a index is laid out exactly like rows of \c pixel, so it can be copied without transforms.
+ */
+template<typename pixel>
+inline bool is_native_layout(const chunk_index& index) noexcept
+{
+	return index.info.get_color_type() == pixel_traits<pixel>::get_color_type()
+		&& index.info.get_bit_depth() == pixel_traits<pixel>::get_bit_depth()
+		&& index.info.get_bit_depth() >= 8
+		&& index.info.get_color_type() != color_type_palette
+		&& index.info.get_interlace_type() == interlace_none
+		&& !index.find(chunk_type_tRNS);
+}
+
+/**
+ * \brief The zlib stream of an image as the list of IDAT payloads it is spread over.
+ */
+class idat_stream
+{
+public:
+	explicit inline idat_stream(const chunk_index& index) : m_pieces(index.get_idat())
+	{
+		uint64_t offset{0};
+		for (const auto& piece : m_pieces)
+		{
+			m_offsets.push_back(offset);
+			offset += piece.size();
+		}
+		m_size = offset;
+	}
+
+	inline uint64_t size() const noexcept
+	{
+		return m_size;
+	}
+
+	/**
+	 * \brief Calls \a fn with the pieces of the bytes [begin, end) of the stream, in order, until it returns \c false.
+	 */
+	template<typename callback>
+	inline void for_each(uint64_t begin, uint64_t end, const callback& fn) const
+	{
+		size_t i{static_cast<size_t>(::std::upper_bound(m_offsets.begin(), m_offsets.end(), begin) - m_offsets.begin() - 1)};
+		for (; i < m_pieces.size() && m_offsets[i] < end; ++i)
+		{
+			const uint64_t from{::std::max(begin, m_offsets[i]) - m_offsets[i]};
+			const uint64_t to{::std::min<uint64_t>(end - m_offsets[i], m_pieces[i].size())};
+			if (!fn(m_pieces[i].subspan(static_cast<size_t>(from), static_cast<size_t>(to - from))))
+			{
+				return;
+			}
+		}
+	}
+
+	/**
+	 * \brief Copies \a count bytes starting at \a begin into \a out.
+	 */
+	inline void copy(uint64_t begin, size_t count, byte* out) const
+	{
+		for_each(begin, begin + count, [&out](::std::span<const byte> piece)
+		{
+			out = ::std::copy(piece.begin(), piece.end(), out);
+			return true;
+		});
+	}
+
+private:
+	::std::vector<::std::span<const byte>> m_pieces;
+	::std::vector<uint64_t> m_offsets;
+	uint64_t m_size{0};
+};
+
+/**
+ * \brief Copies a reconstructed row to its destination, restoring host byte order for 16-bit samples as the reader does.
+ */
+inline void store_row(const byte* row, byte* out, size_t rowbytes, int bit_depth) noexcept
+{
+	if constexpr (__little_endian)
+	{
+		if (bit_depth == 16)
+		{
+			for (size_t i{0}; i + 1 < rowbytes; i += 2)
+			{
+				out[i] = row[i + 1];
+				out[i + 1] = row[i];
+			}
+			return;
+		}
+	}
+	::std::copy(row, row + rowbytes, out);
+}
+
+} // namespace detail
+
+/**
+ * \brief Decodes the image data of \a index strip by strip on up to \a thread_count threads (zero picks the hardware concurrency).
+ *
+ * \a points come from find_split_points(). Each strip is inflated from its own offset in the zlib stream and unfiltered without looking at
+ * the rows in front of it; \a get_row(pos) gives the address row \c pos is stored at and is called concurrently from the workers. The
+ * Adler-32 of the whole stream is checked by combining the checksums of the strips. Throws png::error if the data does not match the
+ * split points.
+ */
+template<typename row_target>
+inline void decode_split(const chunk_index& index, ::std::span<const split_point> points, const row_target& get_row, size_t thread_count = 0)
+{
+	const detail::idat_stream stream(index);
+	if (points.empty() || stream.size() < 6)
+	{
+		throw error("decode_split: no split points");
+	}
+
+	::std::array<byte, 2> header;
+	stream.copy(0, 2, header.data());
+	if ((header[0] & 0x0f) != Z_DEFLATED || (header[0] >> 4) > 7 || (header[0] * 256 + header[1]) % 31 != 0 || (header[1] & 0x20))
+	{
+		throw error("decode_split: invalid zlib header");
+	}
+
+	const size_t rowbytes{index.info.get_rowbytes()};
+	const size_t stride{rowbytes + 1};
+	const size_t bpp{get_filter_bpp(index.info)};
+	const int bit_depth{index.info.get_bit_depth()};
+	const size_t count{points.size()};
+
+	::std::vector<uLong> checksums(count);
+	::std::atomic<size_t> next{0};
+	::std::exception_ptr failure;
+	::std::atomic_flag failed;
+
+	auto work = [&]
+	{
+		try
+		{
+			detail::inflate_stream inflater(-15);
+			::std::vector<byte> filtered;
+			::std::vector<byte> zeros(rowbytes);
+
+			for (size_t i{next++}; i < count; i = next++)
+			{
+				const size_t first{points[i].first_row};
+				const size_t last{i + 1 < count ? points[i + 1].first_row : index.info.get_height()};
+				const uint64_t begin{points[i].offset};
+				const uint64_t end{i + 1 < count ? points[i + 1].offset : stream.size() - 4};
+
+				filtered.resize((last - first) * stride);
+				inflater.reset();
+				size_t produced{0};
+				stream.for_each(begin, end, [&](::std::span<const byte> piece)
+				{
+					while (!piece.empty() && !inflater.is_end())
+					{
+						produced += inflater.inflate(piece, ::std::span(filtered).subspan(produced));
+						if (produced == filtered.size() && !piece.empty())
+						{
+							// only the empty stored block of the flush (or the end of the final block) may follow the last row
+							inflater.inflate(piece, ::std::span(filtered).subspan(produced));
+							if (!piece.empty())
+							{
+								throw error("decode_split: strip holds more data than its rows");
+							}
+						}
+					}
+					return true;
+				});
+				if (produced != filtered.size())
+				{
+					throw error("decode_split: strip holds less data than its rows");
+				}
+				checksums[i] = adler32(filtered);
+
+				const byte* prev{zeros.data()};
+				for (size_t pos{first}; pos < last; ++pos)
+				{
+					byte* row{filtered.data() + (pos - first) * stride};
+					if (pos == first && first > 0 && row[0] != row_filter_none && row[0] != row_filter_sub)
+					{
+						throw error("decode_split: strip does not start with an independent row");
+					}
+					detail::unfilter_row(row[0], row + 1, prev, rowbytes, bpp);
+					detail::store_row(row + 1, reinterpret_cast<byte*>(get_row(pos)), rowbytes, bit_depth);
+					prev = row + 1;
+				}
+			}
+		}
+		catch (...)
+		{
+			if (!failed.test_and_set())
+			{
+				failure = ::std::current_exception();
+			}
+			next = count;
+		}
+	};
+
+	if (thread_count == 0)
+	{
+		thread_count = ::std::max<size_t>(::std::thread::hardware_concurrency(), 1);
+	}
+	detail::run_workers(::std::min(thread_count, count), [&work](size_t){ work(); });
+	if (failure)
+	{
+		::std::rethrow_exception(failure);
+	}
+
+	uLong adler{::adler32(0, nullptr, 0)};
+	for (size_t i{0}; i < count; ++i)
+	{
+		const size_t rows{(i + 1 < count ? points[i + 1].first_row : index.info.get_height()) - points[i].first_row};
+		adler = ::adler32_combine(adler, checksums[i], static_cast<z_off_t>(rows * stride));
+	}
+	::std::array<byte, 4> trailer;
+	stream.copy(stream.size() - 4, 4, trailer.data());
+	if (load_be32(trailer.data()) != static_cast<uint32_t>(adler))
+	{
+		throw error("decode_split: incorrect data check");
+	}
+}
+
+} // namespace png
+
+#endif // PNGPP_SPLIT_INDEX_HPP_INCLUDED
@@ -34,6 +34,10 @@
 #pragma once
 
 //#include <cassert>
+#include <concepts>
+#include <vector>
+
+#include "types.hpp"
 #include "image_info.hpp"
 #include "pixel_traits.hpp"
 
@@ -76,6 +80,41 @@ private:
 	image_info& m_info;
 };
 
+/**
+ * \brief The number of rows consumers and generators implementing \c get_next_rows() hand over at a time, and read or write per libpng call.
+ */
+inline constexpr const size_t row_band_size{64};
+
+/**
+ * \brief Satisfied by pixel consumers and generators with a public \c get_next_rows() method, which hands over a band of rows at once:
+ *
+ * \code
+ * void get_next_rows(size_t pos, size_t count, png::byte** rows);
+ * \endcode
+ *
+ * It stores the starting addresses of rows \c pos to \c pos + \c count - 1 in \c rows[0] to \c rows[count - 1].
+ */
+template<typename pixstream>
+concept row_band_provider = requires(pixstream& stream, size_t pos, size_t count, byte** rows)
+{
+	stream.get_next_rows(pos, count, rows);
+};
+
+/**
+ * \brief Satisfied by pixel consumers and generators whose rows all live in memory at once and that can list them up front:
+ *
+ * \code
+ * std::vector<png::byte*> get_row_pointers();
+ * \endcode
+ *
+ * The whole image is then read or written by one libpng call, see reader::read_image() and writer::write_image().
+ */
+template<typename pixstream>
+concept row_pointers_provider = requires(pixstream& stream)
+{
+	{ stream.get_row_pointers() } -> ::std::same_as<::std::vector<byte*>>;
+};
+
 /**
  * \brief A base class template for consumer and generator classes. Provides default \c reset() method implementation as well as \c info_holder policy.
  */
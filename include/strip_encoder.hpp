@@ -0,0 +1,339 @@
+/**********************************************************************************************************************************************\
+	Copyright© 2021 Mason DeRoss
+
+	Released under either the GNU All-permissive License or MIT license. You pick.
+
+	Copying and distribution of this file, with or without modification, are permitted in any medium without royalty,
+	provided the copyright notice and this notice are preserved. This file is offered as-is, without any warranty.
+
+	DESCRIPTION:
+		Multi-threaded PNG encoding: row strips are filtered and deflated concurrently and stitched into one zlib stream.
+
+\**********************************************************************************************************************************************/
+#ifndef PNGPP_STRIP_ENCODER_HPP_INCLUDED
+#define PNGPP_STRIP_ENCODER_HPP_INCLUDED
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <span>
+#include <thread>
+#include <vector>
+
+extern "C"
+{
+	#include <zlib.h>
+}
+
+#include "config.hpp"
+#include "types.hpp"
+#include "error.hpp"
+#include "image_info.hpp"
+#include "chunk.hpp"
+#include "checksum.hpp"
+#include "filter.hpp"
+#include "filter_chooser.hpp"
+#include "zstream.hpp"
+#include "worker_threads.hpp"
+#include "split_index.hpp"
+#include "writer.hpp"
+
+namespace png
+{
+
+/**
+ * \brief Parameters of the strip_encoder.
+ */
+struct strip_options
+{
+	size_t strip_rows{0};					// rows per strip; 0 picks about 256 KiB of filtered data per strip
+	size_t thread_count{0};					// 0 picks std::thread::hardware_concurrency()
+	int level{Z_DEFAULT_COMPRESSION};
+	size_t idat_size{1 << 16};				// largest IDAT chunk written
+	bool split_points{false};				// make every strip decodable on its own and record the strips in an spIX chunk
+	filter_heuristic heuristic{filter_heuristic_default};	// how the filter of each row is picked, see filter_chooser
+	int sticky_gain{10};					// filter_heuristic_sticky: percent of the previous filter's cost a new filter must save
+};
+
+/**
+ * \brief Encodes the image data of a non-interlaced image on several threads, pigz style.
+ *
+ * The rows are cut into strips of a fixed number of rows. Every strip is filtered and deflated on its own by one of the worker threads,
+ * primed with the last 32K of filtered data in front of it, and ends with a zlib full flush; the strips are then concatenated behind a
+ * zlib header and the Adler-32 of the whole stream is put together with \c adler32_combine(). Because the strip layout depends only on
+ * \c strip_rows and never on the number of threads, the output is byte-identical for any \c thread_count.
+ *
+ * Rows use the same layout as with the generator class, 16-bit samples in host byte order. Rows are filtered by a filter_chooser with
+ * \c strip_options::heuristic; the default is libpng's: no filter for palette and sub-byte images, otherwise the filter with the lowest
+ * sum of absolute differences. The sticky heuristic starts afresh every sticky_restart_rows rows, so that the rows in front of a strip
+ * can be filtered again exactly as their own strip did.
+ *
+ * With \c split_points the strips are not primed and the first row of each one is filtered with None or Sub, so every strip can be
+ * inflated and unfiltered without the data in front of it; the spIX chunk lists the first row and zlib stream offset of every strip
+ * for decode_split(). Any other decoder reads the file as usual.
+ *
+ * \see image::write_parallel(), generator, decode_split()
+ */
+class strip_encoder
+{
+public:
+	explicit inline strip_encoder(const image_info& info, const strip_options& options = strip_options())
+		: m_info(info), m_options(options), m_rowbytes(info.get_rowbytes())
+	{
+		if (m_info.get_interlace_type() != interlace_none)
+		{
+			throw error("strip_encoder: interlaced images are not supported");
+		}
+		if (m_options.strip_rows == 0)
+		{
+			m_options.strip_rows = ::std::max<size_t>((256 << 10) / (m_rowbytes + 1), 1);
+		}
+		if (m_options.thread_count == 0)
+		{
+			m_options.thread_count = ::std::max<size_t>(::std::thread::hardware_concurrency(), 1);
+		}
+		m_adaptive = filter_chooser(m_info, m_options.heuristic).get_filters() != PNG_FILTER_NONE;
+	}
+
+	inline size_t get_strip_rows() const noexcept
+	{
+		return m_options.strip_rows;
+	}
+
+	inline size_t get_strip_count() const noexcept
+	{
+		return (m_info.get_height() + m_options.strip_rows - 1) / m_options.strip_rows;
+	}
+
+	/**
+	 * \brief Produces the zlib stream holding the filtered image data.
+	 *
+	 * \a get_row(pos) returns the address of row \c pos and is called concurrently from the worker threads. \a sink receives the stream
+	 * in order, as a sequence of \c std::span<const \c byte>, on the calling thread.
+	 */
+	template<typename row_source, typename byte_sink>
+	inline void encode(const row_source& get_row, const byte_sink& sink)
+	{
+		compress(get_row);
+		emit(sink);
+	}
+
+	/**
+	 * \brief Returns the first row and zlib stream offset of every strip of the last encode() or write(), the contents of the spIX chunk.
+	 */
+	inline ::std::vector<split_point> get_split_points() const
+	{
+		::std::vector<split_point> points;
+		uint64_t offset{2};
+		for (size_t i{0}; i < m_sizes.size(); ++i)
+		{
+			points.push_back({static_cast<uint32_t>(i * m_options.strip_rows), offset});
+			offset += m_sizes[i];
+		}
+		return points;
+	}
+
+	/**
+	 * \brief Writes the complete PNG data stream to \a stream: the header chunks through libpng, then the IDAT chunks and IEND.
+	 *
+	 * With \c strip_options::split_points an spIX chunk recording where each strip starts goes in front of the first IDAT.
+	 */
+	template<typename ostream, typename row_source>
+	inline void write(ostream& stream, const row_source& get_row)
+	{
+		compress(get_row);
+
+		{
+			writer<ostream> wr(stream);
+			wr.set_image_info(m_info);
+			wr.write_info();
+		}
+
+		if (m_options.split_points)
+		{
+			write_chunk(stream, chunk_type_spIX, make_split_index(get_split_points()));
+		}
+
+		idat_writer<ostream> idat(stream, m_options.idat_size);
+		emit([&idat](::std::span<const byte> bytes){ idat.write(bytes); });
+		idat.flush();
+
+		write_chunk(stream, chunk_type_IEND, {});
+		stream.flush();
+	}
+
+private:
+	template<typename row_source>
+	inline void compress(const row_source& get_row)
+	{
+		const size_t count{get_strip_count()};
+		m_strips.assign(count, {});
+		m_sizes.clear();
+		m_checksums.assign(count, 0);
+		::std::atomic<size_t> next{0};
+		::std::exception_ptr failure;
+		::std::atomic_flag failed;
+
+		auto work = [&]
+		{
+			try
+			{
+				worker state(m_info, m_options, m_adaptive ? Z_FILTERED : Z_DEFAULT_STRATEGY);
+				for (size_t i{next++}; i < count; i = next++)
+				{
+					m_checksums[i] = encode_strip(i, state, get_row, m_strips[i]);
+				}
+			}
+			catch (...)
+			{
+				if (!failed.test_and_set())
+				{
+					failure = ::std::current_exception();
+				}
+				next = count;
+			}
+		};
+
+		detail::run_workers(::std::min(m_options.thread_count, count), [&work](size_t){ work(); });
+		if (failure)
+		{
+			::std::rethrow_exception(failure);
+		}
+
+		for (const auto& strip : m_strips)
+		{
+			m_sizes.push_back(strip.size());
+		}
+	}
+
+	template<typename byte_sink>
+	inline void emit(const byte_sink& sink)
+	{
+		const ::std::array<byte, 2> header{0x78, detail::zlib_header_flags(m_options.level)};
+		sink(::std::span<const byte>(header));
+
+		uLong adler{::adler32(0, nullptr, 0)};
+		for (size_t i{0}; i < m_strips.size(); ++i)
+		{
+			sink(::std::span<const byte>(m_strips[i]));
+			::std::vector<byte>().swap(m_strips[i]);
+
+			const size_t rows{::std::min(m_options.strip_rows, m_info.get_height() - i * m_options.strip_rows)};
+			adler = ::adler32_combine(adler, m_checksums[i], static_cast<z_off_t>(rows * (m_rowbytes + 1)));
+		}
+
+		::std::array<byte, 4> trailer;
+		store_be32(trailer.data(), static_cast<uint32_t>(adler));
+		sink(::std::span<const byte>(trailer));
+	}
+
+	/**
+	 * \brief Per-thread scratch space, reused for every strip the thread encodes.
+	 */
+	struct worker
+	{
+		inline worker(const image_info& info, const strip_options& options, int strategy)
+			: stream(options.level, -15, 8, strategy), chooser(info, options.heuristic, 0, options.sticky_gain) {}
+
+		detail::deflate_stream stream;
+		filter_chooser chooser;
+		::std::vector<byte> filtered;
+		::std::vector<byte> row;
+		::std::vector<byte> prev;
+	};
+
+	static inline constexpr size_t sticky_restart_rows{16};
+
+	template<typename row_source>
+	inline const byte* load_row(const row_source& get_row, size_t pos, ::std::vector<byte>& buffer) const
+	{
+		const byte* row{reinterpret_cast<const byte*>(get_row(pos))};
+		if constexpr (__little_endian)
+		{
+			if (m_info.get_bit_depth() == 16)
+			{
+				buffer.resize(m_rowbytes);
+				for (size_t i{0}; i + 1 < m_rowbytes; i += 2)
+				{
+					buffer[i] = row[i + 1];
+					buffer[i + 1] = row[i];
+				}
+				return buffer.data();
+			}
+		}
+		return row;
+	}
+
+	template<typename row_source>
+	inline uLong encode_strip(size_t strip, worker& state, const row_source& get_row, ::std::vector<byte>& out) const
+	{
+		const size_t stride{m_rowbytes + 1};
+		const size_t first{strip * m_options.strip_rows};
+		const size_t last{::std::min(first + m_options.strip_rows, static_cast<size_t>(m_info.get_height()))};
+
+		// the rows in front of the strip whose filtered bytes prime the deflate window; none when the strips must decode on their own
+		const size_t dictionary_rows{m_options.split_points ? 0 : ::std::min(first, (size_t{32768} + stride - 1) / stride)};
+		// filtering starts where the filter choices do not depend on rows further up
+		const size_t begin{m_options.split_points ? first : (first - dictionary_rows) / sticky_restart_rows * sticky_restart_rows};
+
+		state.filtered.resize((last - begin) * stride);
+		state.prev.assign(m_rowbytes, 0);
+		const byte* prev{nullptr};
+		if (begin > 0)
+		{
+			prev = load_row(get_row, begin - 1, state.prev);
+		}
+
+		byte* out_row{state.filtered.data()};
+		for (size_t pos{begin}; pos < last; ++pos, out_row += stride)
+		{
+			const byte* row{load_row(get_row, pos, state.row)};
+			if (pos == begin || pos % sticky_restart_rows == 0)
+			{
+				state.chooser.reset();
+			}
+			if (m_options.split_points && pos == first && first > 0)
+			{
+				state.chooser.filter_independent(row, out_row);
+			}
+			else
+			{
+				state.chooser.filter(row, prev, out_row);
+			}
+
+			if (row == state.row.data())
+			{
+				state.row.swap(state.prev);
+				prev = state.prev.data();
+			}
+			else
+			{
+				prev = row;
+			}
+		}
+
+		const ::std::span<const byte> filtered(state.filtered);
+		const size_t front{(first - begin) * stride};
+		const size_t dictionary_size{::std::min<size_t>(dictionary_rows * stride, 32768)};
+		const auto dictionary{filtered.subspan(front - dictionary_size, dictionary_size)};
+		const auto input{filtered.subspan(front)};
+
+		state.stream.compress(dictionary, input, last == m_info.get_height() ? Z_FINISH : Z_FULL_FLUSH, out);
+
+		return adler32(input);
+	}
+
+	image_info m_info;
+	strip_options m_options;
+	size_t m_rowbytes;
+	bool m_adaptive;
+	::std::vector<::std::vector<byte>> m_strips;
+	::std::vector<uLong> m_checksums;
+	::std::vector<size_t> m_sizes;
+};
+
+} // namespace png
+
+#endif // PNGPP_STRIP_ENCODER_HPP_INCLUDED
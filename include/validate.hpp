@@ -0,0 +1,142 @@
+/**********************************************************************************************************************************************\
+	Copyright© 2021 Mason DeRoss
+
+	Released under either the GNU All-permissive License or MIT license. You pick.
+
+	Copying and distribution of this file, with or without modification, are permitted in any medium without royalty,
+	provided the copyright notice and this notice are preserved. This file is offered as-is, without any warranty.
+
+	DESCRIPTION:
+		Integrity check of a whole PNG data stream, every row decoded and thrown away, without an image to hold the pixels.
+
+\**********************************************************************************************************************************************/
+#ifndef PNGPP_VALIDATE_HPP_INCLUDED
+#define PNGPP_VALIDATE_HPP_INCLUDED
+
+#pragma once
+
+#include <array>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "types.hpp"
+#include "error.hpp"
+#include "chunk.hpp"
+#include "chunk_scanner.hpp"
+#include "decode_options.hpp"
+#include "mapped_file.hpp"
+#include "native_decoder.hpp"
+#include "probe.hpp"
+#include "reader.hpp"
+#include "span_istream.hpp"
+
+namespace png
+{
+
+/**
+ * \brief The outcome of validate(): OK, or the first error along with where the reader was when it hit it.
+ */
+struct validation_result
+{
+	bool ok{true};
+	::std::string message;					// the error, empty if ok
+	chunk_type chunk{0};					// the chunk being read, 0 for the signature or when ok
+	size_t offset{0};						// the bytes of the data stream read up to the error
+
+	explicit inline operator bool() const noexcept
+	{
+		return ok;
+	}
+};
+
+namespace detail
+{
+
+/**
+ * \brief Runs the reader over the whole of \a bytes, every row of every pass going into one scratch row.
+ */
+inline validation_result validate_with_reader(::std::span<const byte> bytes, const decode_options& options)
+{
+	span_istream stream(bytes);
+	reader<span_istream> rd(stream);
+	if (options.verify_crc)
+	{
+		// a bad CRC on an ancillary chunk is only a warning to libpng, which drops the chunk and reads on
+		png_set_crc_action(rd.get_png_struct(), PNG_CRC_ERROR_QUIT, PNG_CRC_ERROR_QUIT);
+	}
+	try
+	{
+		rd.read_info(options);
+		const size_t pass_count{rd.get_interlace_type() != interlace_none ? static_cast<size_t>(rd.set_interlace_handling()) : 1};
+		rd.update_info();
+
+		::std::vector<byte> row(png_get_rowbytes(rd.get_png_struct(), rd.get_info().get_png_info()));
+		for (size_t pass{0}; pass < pass_count; ++pass)
+		{
+			for (uint32_t pos{0}; pos < rd.get_height(); ++pos)
+			{
+				rd.read_row(row.data());
+			}
+		}
+		rd.read_end_info();
+	}
+	catch (const error& e)
+	{
+		return {false, e.what(), png_get_io_chunk_type(rd.get_png_struct()), stream.tell()};
+	}
+	return {};
+}
+
+} // namespace detail
+
+/**
+ * \brief Checks that \a bytes hold a valid PNG data stream: every chunk, CRC, the zlib stream and the filter of every row, as a full read
+ * would, without storing the pixels. Unlike a read, a bad CRC on an ancillary chunk fails too.
+ *
+ * 8-bit non-interlaced images are decoded by decode_native() into two alternating rows; other images, and any image the native decoder
+ * finds fault with, go through the reader, one row at a time into a single row, so that the error comes with libpng's message and
+ * position. Either way the memory used does not grow with the height of the image. \a options turns checks off, as for image::read().
+ */
+inline validation_result validate(::std::span<const byte> bytes, const decode_options& options = decode_options())
+{
+	image_info header;
+	if (try_probe(bytes, header) && header.get_bit_depth() == 8 && header.get_interlace_type() == interlace_none)
+	{
+		const auto index{scan_chunks(bytes, scan_options{options.verify_crc})};
+		if (detail::can_decode_native(index))
+		{
+			try
+			{
+				::std::array<::std::vector<byte>, 2> rows{::std::vector<byte>(index.info.get_rowbytes()),
+					::std::vector<byte>(index.info.get_rowbytes())};
+				decode_native(index, [&rows](size_t pos){ return rows[pos & 1].data(); }, options);
+				return {};
+			}
+			catch (const error&)
+			{
+				// read it again for the details
+			}
+		}
+	}
+	return detail::validate_with_reader(bytes, options);
+}
+
+/**
+ * \brief Validates the PNG file named \a filename, memory mapped. Throws png::std_error if the file cannot be opened.
+ */
+inline validation_result validate(const char* filename, const decode_options& options = decode_options())
+{
+	mapped_file file(filename);
+	return validate(file.get_bytes(), options);
+}
+
+inline validation_result validate(const ::std::filesystem::path& path, const decode_options& options = decode_options())
+{
+	return validate(path.string().c_str(), options);
+}
+
+} // namespace png
+
+#endif // PNGPP_VALIDATE_HPP_INCLUDED
@@ -0,0 +1,90 @@
+/**********************************************************************************************************************************************\
+	Copyright© 2021 Mason DeRoss
+
+	Released under either the GNU All-permissive License or MIT license. You pick.
+
+	Copying and distribution of this file, with or without modification, are permitted in any medium without royalty,
+	provided the copyright notice and this notice are preserved. This file is offered as-is, without any warranty.
+
+	DESCRIPTION:
+		Growable in-memory output stream, usable as the output stream of png::writer.
+
+\**********************************************************************************************************************************************/
+#ifndef PNGPP_VECTOR_OSTREAM_HPP_INCLUDED
+#define PNGPP_VECTOR_OSTREAM_HPP_INCLUDED
+
+#pragma once
+
+#include <span>
+#include <vector>
+#include <memory>
+#include <memory_resource>
+
+#include "types.hpp"
+
+namespace png
+{
+
+/**
+ * \brief Collects the encoded PNG data stream in a \c std::vector of bytes.
+ *
+ * Implements the \c ostream interface expected by the writer class. Pass the expected output size to the constructor (see
+ * estimate_encoded_size()) to reserve the storage up front, so it seldom has to grow; the encoded bytes are then handed over with
+ * \c release() without a copy.
+ *
+ * The \c allocator template parameter allows the buffer to live in an arena, e.g. \c std::pmr::polymorphic_allocator<byte> backed by a
+ * \c std::pmr::monotonic_buffer_resource (see pmr_vector_ostream).
+ *
+ * \see writer, image::write_to_memory()
+ */
+template<typename allocator = ::std::allocator<byte>>
+class vector_ostream
+{
+public:
+	using vector_type = ::std::vector<byte, allocator>;
+
+	explicit inline vector_ostream(size_t capacity = 0, const allocator& alloc = allocator()) : m_bytes(alloc)
+	{
+		m_bytes.reserve(capacity);
+	}
+
+	inline void write(const char* data, size_t length)
+	{
+		auto bytes{reinterpret_cast<const byte*>(data)};
+		m_bytes.insert(m_bytes.end(), bytes, bytes + length);
+	}
+
+	inline constexpr void flush() const noexcept {}
+
+	inline constexpr bool good() const noexcept
+	{
+		return true;
+	}
+
+	inline constexpr ::std::span<const byte> get_bytes() const noexcept
+	{
+		return m_bytes;
+	}
+
+	/**
+	 * \brief Moves the collected bytes out to the caller, leaving the stream empty.
+	 */
+	inline constexpr vector_type release() noexcept
+	{
+		auto tmp{::std::move(m_bytes)};
+		m_bytes.clear();
+		return tmp;
+	}
+
+private:
+	vector_type m_bytes;
+};
+
+/**
+ * \brief vector_ostream drawing its storage from a \c std::pmr::memory_resource.
+ */
+using pmr_vector_ostream = vector_ostream<::std::pmr::polymorphic_allocator<byte>>;
+
+} // namespace png
+
+#endif // PNGPP_VECTOR_OSTREAM_HPP_INCLUDED
@@ -0,0 +1,58 @@
+/**********************************************************************************************************************************************\
+	Copyright© 2021 Mason DeRoss
+
+	Released under either the GNU All-permissive License or MIT license. You pick.
+
+	Copying and distribution of this file, with or without modification, are permitted in any medium without royalty,
+	provided the copyright notice and this notice are preserved. This file is offered as-is, without any warranty.
+
+	DESCRIPTION:
+		Runs one function on a number of threads, the calling thread included, for the parallel encoders and decoders.
+
+\**********************************************************************************************************************************************/
+#ifndef PNGPP_WORKER_THREADS_HPP_INCLUDED
+#define PNGPP_WORKER_THREADS_HPP_INCLUDED
+
+#pragma once
+
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace png
+{
+
+namespace detail
+{
+
+/**
+ * \brief Calls \a work(t) on \a thread_count threads, \c t being 0 on the calling thread and 1 to \a thread_count - 1 on the others, and
+ * returns once every call has returned.
+ *
+ * \a work is expected to take its items from a shared counter, so a thread the system cannot start is simply left out: the threads that
+ * did start, and the calling thread, get through all of the items. The threads are joined whichever way this function is left.
+ */
+template<typename function>
+inline void run_workers(size_t thread_count, const function& work)
+{
+	::std::vector<::std::jthread> threads;
+	try
+	{
+		threads.reserve(thread_count > 1 ? thread_count - 1 : 0);
+		for (size_t t{1}; t < thread_count; ++t)
+		{
+			threads.emplace_back(work, t);
+		}
+	}
+	catch (const ::std::system_error&)
+	{
+		// out of threads: carry on with the ones running
+	}
+	work(size_t{0});
+}
+
+} // namespace detail
+
+} // namespace png
+
+#endif // PNGPP_WORKER_THREADS_HPP_INCLUDED
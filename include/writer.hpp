@@ -34,7 +34,9 @@
 #pragma once
 
 //#include <cassert>
+#include "memory_usage.hpp"
 #include "io_base.hpp"
+#include "encode_options.hpp"
 
 namespace png
 {
@@ -57,17 +59,21 @@ namespace png
  *
  * With the semantics similar to the \c std::ostream. Naturally, \c std::ostream fits this requirement and can be used with the writer class as is.
  *
+ * Every allocation libpng and zlib make for the writer is counted, see get_memory_usage(). Most of it is zlib's deflate state, which
+ * encode_options::window_bits and encode_options::mem_level size, see encode_options::low_memory().
+ *
  * \see image, reader, generator, io_base
  */
 template<class ostream>
-class writer : public io_base
+class writer : public detail::memory_counter, public io_base
 {
 public:
 	/**
 	 * \brief Constructs a writer prepared to write PNG image into a \a stream.
 	 */
 	explicit inline constexpr writer(ostream& stream) noexcept
-		: io_base(png_create_write_struct(PNG_LIBPNG_VER_STRING, static_cast<io_base*>(this), raise_error, 0))
+		: io_base(png_create_write_struct_2(PNG_LIBPNG_VER_STRING, static_cast<io_base*>(this), raise_error, 0,
+			static_cast<detail::memory_counter*>(this), allocate, release))
 	{
 		png_set_write_fn(m_png.get(), &stream, write_data, flush_data);
 	}
@@ -99,6 +105,49 @@ public:
 		m_info.write();
 	}
 
+	/**
+	 * \brief Applies the compression settings in \a options. Call it before write_info().
+	 */
+	inline void set_encode_options(const encode_options& options) const
+	{
+		if (setjmp(png_jmpbuf(m_png.get())))
+		{
+			throw error(m_error);
+		}
+		png_set_compression_level(m_png.get(), options.level);
+		if (options.strategy != encode_options::default_strategy)
+		{
+			png_set_compression_strategy(m_png.get(), options.strategy);
+		}
+		png_set_compression_window_bits(m_png.get(), options.window_bits);
+		png_set_compression_mem_level(m_png.get(), options.mem_level);
+		png_set_compression_buffer_size(m_png.get(), options.idat_size);
+		if (options.filters != 0)
+		{
+			png_set_filter(m_png.get(), PNG_FILTER_TYPE_BASE, options.filters);
+		}
+		else if (options.heuristic != filter_heuristic_default)
+		{
+			// every filter the rows may get has to be enabled before the first row, see set_filter()
+			png_set_filter(m_png.get(), PNG_FILTER_TYPE_BASE, PNG_ALL_FILTERS);
+		}
+	}
+
+	/**
+	 * \brief Restricts the filters libpng picks from for the following rows, PNG_FILTER_NONE, PNG_FILTER_SUB, ... or'ed together.
+	 *
+	 * Given a single filter libpng applies it without rating any other. Once rows are written, Up, Avg and Paeth can only be used if they
+	 * were enabled before the first row.
+	 */
+	inline void set_filter(int filters) const
+	{
+		if (setjmp(png_jmpbuf(m_png.get())))
+		{
+			throw error(m_error);
+		}
+		png_set_filter(m_png.get(), PNG_FILTER_TYPE_BASE, filters);
+	}
+
 	/**
 	 * \brief Writes a row of image data at a time.
 	 */
@@ -111,6 +160,32 @@ public:
 		png_write_row(m_png.get(), bytes);
 	}
 
+	/**
+	 * \brief Writes \a count rows of image data at a time, from \a rows[0] to \a rows[count - 1].
+	 *
+	 * One \c setjmp() and one libpng call for the whole band rather than one of each per row.
+	 */
+	inline void write_rows(byte** rows, size_t count) const
+	{
+		if (setjmp(png_jmpbuf(m_png.get())))
+		{
+			throw error(m_error);
+		}
+		png_write_rows(m_png.get(), rows, static_cast<png_uint_32>(count));
+	}
+
+	/**
+	 * \brief Writes the whole image, every interlace pass, from the rows \a rows points to, one per image row.
+	 */
+	inline void write_image(byte** rows) const
+	{
+		if (setjmp(png_jmpbuf(m_png.get())))
+		{
+			throw error(m_error);
+		}
+		png_write_image(m_png.get(), rows);
+	}
+
 	/**
 	 * \brief Reads ending info about PNG image.
 	 */
@@ -126,7 +201,7 @@ public:
 private:
 	static inline constexpr void write_data(png_struct* png, byte* data, png_size_t length) noexcept
 	{
-		auto wr{static_cast<writer*>(png_get_error_ptr(png))};
+		auto wr{static_cast<writer*>(static_cast<io_base*>(png_get_error_ptr(png)))};
 		wr->reset_error();
 		auto stream{reinterpret_cast<ostream*>(png_get_io_ptr(png))};
 		try
@@ -154,7 +229,7 @@ private:
 
 	static inline constexpr void flush_data(png_struct* png) noexcept
 	{
-		auto wr{static_cast<writer*>(png_get_error_ptr(png))};
+		auto wr{static_cast<writer*>(static_cast<io_base*>(png_get_error_ptr(png)))};
 		wr->reset_error();
 		auto stream{reinterpret_cast<ostream*>(png_get_io_ptr(png))};
 		try
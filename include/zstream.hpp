@@ -0,0 +1,258 @@
+/**********************************************************************************************************************************************\
+	Copyright© 2021 Mason DeRoss
+
+	Released under either the GNU All-permissive License or MIT license. You pick.
+
+	Copying and distribution of this file, with or without modification, are permitted in any medium without royalty,
+	provided the copyright notice and this notice are preserved. This file is offered as-is, without any warranty.
+
+	DESCRIPTION:
+		Owning wrappers around zlib streams, for the code paths that deflate or inflate IDAT data without libpng.
+
+\**********************************************************************************************************************************************/
+#ifndef PNGPP_ZSTREAM_HPP_INCLUDED
+#define PNGPP_ZSTREAM_HPP_INCLUDED
+
+#pragma once
+
+#include <span>
+#include <string>
+#include <vector>
+
+extern "C"
+{
+	#include <zlib.h>
+}
+
+#include "types.hpp"
+#include "error.hpp"
+
+namespace png
+{
+
+namespace detail
+{
+
+/**
+ * \brief Returns the second byte of a zlib header for a 32K window at compression \a level, as deflate() would write it.
+ */
+inline constexpr byte zlib_header_flags(int level) noexcept
+{
+	int flevel{2};
+	if (level >= 0 && level < 2)
+	{
+		flevel = 0;
+	}
+	else if (level >= 2 && level < 6)
+	{
+		flevel = 1;
+	}
+	else if (level > 6)
+	{
+		flevel = 3;
+	}
+	const int flags{flevel << 6};
+	return static_cast<byte>(flags + 31 - (0x78 * 256 + flags) % 31);
+}
+
+/**
+ * \brief A raw deflate stream, owned.
+ */
+class deflate_stream
+{
+private:
+	deflate_stream(const deflate_stream&) = delete;
+	deflate_stream(deflate_stream&&) = delete;
+
+	deflate_stream& operator=(const deflate_stream&) = delete;
+	deflate_stream& operator=(deflate_stream&&) = delete;
+
+public:
+	inline deflate_stream(int level, int window_bits, int mem_level, int strategy)
+	{
+		if (deflateInit2(&m_stream, level, Z_DEFLATED, window_bits, mem_level, strategy) != Z_OK)
+		{
+			throw error("deflate_stream: deflateInit2() failed");
+		}
+	}
+
+	inline ~deflate_stream() noexcept
+	{
+		deflateEnd(&m_stream);
+	}
+
+	/**
+	 * \brief Compresses \a input after \a dictionary and appends the output to \a out, ending with \a flush (Z_FULL_FLUSH or Z_FINISH).
+	 */
+	inline void compress(::std::span<const byte> dictionary, ::std::span<const byte> input, int flush, ::std::vector<byte>& out)
+	{
+		if (deflateReset(&m_stream) != Z_OK)
+		{
+			throw error("deflate_stream: deflateReset() failed");
+		}
+		if (!dictionary.empty()
+			&& deflateSetDictionary(&m_stream, dictionary.data(), static_cast<uInt>(dictionary.size())) != Z_OK)
+		{
+			throw error("deflate_stream: deflateSetDictionary() failed");
+		}
+
+		m_stream.next_in = const_cast<byte*>(input.data());
+		m_stream.avail_in = static_cast<uInt>(input.size());
+		size_t used{out.size()};
+		out.resize(used + deflateBound(&m_stream, static_cast<uLong>(input.size())) + 16);
+
+		for (;;)
+		{
+			m_stream.next_out = out.data() + used;
+			m_stream.avail_out = static_cast<uInt>(out.size() - used);
+			const int result{deflate(&m_stream, flush)};
+			used = out.size() - m_stream.avail_out;
+			if (result == Z_STREAM_END || (result == Z_OK && m_stream.avail_out != 0 && flush != Z_FINISH))
+			{
+				break;
+			}
+			if (result != Z_OK && result != Z_BUF_ERROR)
+			{
+				throw error("deflate_stream: deflate() failed");
+			}
+			out.resize(out.size() * 2);
+		}
+		out.resize(used);
+	}
+
+private:
+	z_stream m_stream{};
+};
+
+/**
+ * \brief An inflate stream, owned.
+ */
+class inflate_stream
+{
+private:
+	inflate_stream(const inflate_stream&) = delete;
+	inflate_stream(inflate_stream&&) = delete;
+
+	inflate_stream& operator=(const inflate_stream&) = delete;
+	inflate_stream& operator=(inflate_stream&&) = delete;
+
+public:
+	/**
+	 * \brief \a window_bits as for \c inflateInit2(): -15 for raw deflate data, 15 for a zlib stream.
+	 */
+	explicit inline inflate_stream(int window_bits)
+	{
+		if (inflateInit2(&m_stream, window_bits) != Z_OK)
+		{
+			throw error("inflate_stream: inflateInit2() failed");
+		}
+	}
+
+	inline ~inflate_stream() noexcept
+	{
+		inflateEnd(&m_stream);
+	}
+
+	inline void reset()
+	{
+		m_end = false;
+		if (inflateReset(&m_stream) != Z_OK)
+		{
+			throw error("inflate_stream: inflateReset() failed");
+		}
+	}
+
+	/**
+	 * \brief Inflates as much of \a input into \a output as fits; returns the number of bytes written and advances \a input.
+	 *
+	 * With \a flush set to Z_BLOCK inflation also stops at the end of every deflate block, see get_block_bits(). Throws png::error on
+	 * corrupt data.
+	 */
+	inline size_t inflate(::std::span<const byte>& input, ::std::span<byte> output, int flush = Z_NO_FLUSH)
+	{
+		m_stream.next_in = const_cast<byte*>(input.data());
+		m_stream.avail_in = static_cast<uInt>(input.size());
+		m_stream.next_out = output.data();
+		m_stream.avail_out = static_cast<uInt>(output.size());
+
+		const int result{::inflate(&m_stream, flush)};
+		if (result == Z_STREAM_END)
+		{
+			m_end = true;
+		}
+		else if (result != Z_OK && result != Z_BUF_ERROR)
+		{
+			throw error(::std::string("inflate_stream: ") + (m_stream.msg ? m_stream.msg : "inflate() failed"));
+		}
+
+		input = input.last(m_stream.avail_in);
+		return output.size() - m_stream.avail_out;
+	}
+
+	/**
+	 * \brief Stops checking the Adler-32 at the end of a zlib stream, see decode_options::verify_adler. Does nothing before zlib 1.2.9.
+	 *
+	 * Holds until the stream is destroyed; reset() keeps it.
+	 */
+	inline void skip_check() noexcept
+	{
+#if ZLIB_VERNUM >= 0x1290
+		inflateValidate(&m_stream, 0);
+#endif
+	}
+
+	/**
+	 * \brief Returns \c true once the final deflate block has been inflated.
+	 */
+	inline bool is_end() const noexcept
+	{
+		return m_end;
+	}
+
+	/**
+	 * \brief Returns \c true if inflation stopped right after a deflate block that is not the last one.
+	 */
+	inline bool is_block_boundary() const noexcept
+	{
+		return (m_stream.data_type & 128) && !(m_stream.data_type & 64);
+	}
+
+	/**
+	 * \brief At a block boundary, the number of bits of the last input byte that belong to the next block.
+	 */
+	inline int get_block_bits() const noexcept
+	{
+		return m_stream.data_type & 7;
+	}
+
+	/**
+	 * \brief Resumes inflation in the middle of a deflate stream: feeds the \a bits upper bits of \a last_byte and sets the 32K of
+	 * output in front of the resume point. Call right after reset().
+	 */
+	inline void resume(int bits, byte last_byte, ::std::span<const byte> window)
+	{
+		if (bits && inflatePrime(&m_stream, bits, last_byte >> (8 - bits)) != Z_OK)
+		{
+			throw error("inflate_stream: inflatePrime() failed");
+		}
+		if (!window.empty() && inflateSetDictionary(&m_stream, window.data(), static_cast<uInt>(window.size())) != Z_OK)
+		{
+			throw error("inflate_stream: inflateSetDictionary() failed");
+		}
+	}
+
+	inline z_stream& get() noexcept
+	{
+		return m_stream;
+	}
+
+private:
+	z_stream m_stream{};
+	bool m_end{false};
+};
+
+} // namespace detail
+
+} // namespace png
+
+#endif // PNGPP_ZSTREAM_HPP_INCLUDED
@@ -20,6 +20,69 @@
 #include <windows.h>
 
 #define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
 #pragma warning(push, 0)
 #include "catch/catch.hpp"
 #pragma warning(pop)
+
+#include <vector>
+
+#include "../include/png.hpp"
+#include "../include/encode_options.hpp"
+#include "../include/vector_ostream.hpp"
+
+namespace png::testing
+{
+
+// smooth gradients with a noisy band in the middle, so the filters and zlib levels both have something to do; a different image per seed
+static inline image<rgb_pixel> make_test_image(uint32_t width, uint32_t height, uint32_t seed = 0)
+{
+	image<rgb_pixel> img(width, height);
+	uint32_t noise{1};
+	for (uint32_t y{0}; y < height; ++y)
+	{
+		for (uint32_t x{0}; x < width; ++x)
+		{
+			rgb_pixel p(static_cast<byte>(x + seed), static_cast<byte>(y), static_cast<byte>((x + y) / 4 + seed * 7));
+			if (y >= height * 5 / 12 && y < height * 7 / 12)
+			{
+				noise = noise * 1103515245 + 12345;
+				p.blue = static_cast<byte>(noise >> 24);
+			}
+			img.set_pixel(x, y, p);
+		}
+	}
+	return img;
+}
+
+template<typename pixel>
+static inline ::std::vector<byte> encode(image<pixel>& img, const encode_options& options = encode_options())
+{
+	vector_ostream<> png;
+	img.write_stream(png, options);
+	return png.release();
+}
+
+template<typename pixel>
+static inline bool same_pixels(const image<pixel>& lhs, const image<pixel>& rhs)
+{
+	if (lhs.get_width() != rhs.get_width() || lhs.get_height() != rhs.get_height())
+	{
+		return false;
+	}
+	for (uint32_t y{0}; y < lhs.get_height(); ++y)
+	{
+		for (uint32_t x{0}; x < lhs.get_width(); ++x)
+		{
+			const auto a{lhs.get_pixel(x, y)};
+			const auto b{rhs.get_pixel(x, y)};
+			if (a.red != b.red || a.green != b.green || a.blue != b.blue)
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+} // namespace png::testing
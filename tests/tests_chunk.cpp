@@ -0,0 +1,493 @@
+/**********************************************************************************************************************************************\
+	Copyright© 2021 Mason DeRoss
+
+	Released under either the GNU All-permissive License or MIT license. You pick.
+
+	Copying and distribution of this file, with or without modification, are permitted in any medium without royalty,
+	provided the copyright notice and this notice are preserved. This file is offered as-is, without any warranty.
+
+	DESCRIPTION:
+		Tests for the chunk level tools working on the raw PNG data stream.
+
+\**********************************************************************************************************************************************/
+//#include "../include/stdafx.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+#include "../include/png.hpp"
+#include "../include/probe.hpp"
+#include "../include/checksum.hpp"
+#include "../include/chunk_editor.hpp"
+#include "../include/chunk_scanner.hpp"
+#include "../include/strip_encoder.hpp"
+#include "../include/fast_encoder.hpp"
+#include "../include/split_index.hpp"
+#include "../include/row_index.hpp"
+#include "../include/native_decoder.hpp"
+#include "../include/vector_ostream.hpp"
+
+#include "tests.h"
+
+namespace png::testing
+{
+
+// 3x2 8-bit grayscale image with a tEXt chunk (Title: png++)
+static constexpr const ::std::array<byte, 96> gray_3x2{
+	0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a, 0x00, 0x00, 0x00, 0x0d, 0x49, 0x48, 0x44, 0x52, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00,
+	0x00, 0x02, 0x08, 0x00, 0x00, 0x00, 0x00, 0xb8, 0x1f, 0x39, 0xc6, 0x00, 0x00, 0x00, 0x0b, 0x74, 0x45, 0x58, 0x74, 0x54, 0x69, 0x74,
+	0x6c, 0x65, 0x00, 0x70, 0x6e, 0x67, 0x2b, 0x2b, 0x49, 0x43, 0x07, 0x23, 0x00, 0x00, 0x00, 0x10, 0x49, 0x44, 0x41, 0x54, 0x78, 0x9c,
+	0x63, 0x60, 0x10, 0x50, 0x60, 0x60, 0x14, 0x54, 0x04, 0x00, 0x01, 0x4e, 0x00, 0x64, 0xd2, 0xa4, 0xd7, 0x09, 0x00, 0x00, 0x00, 0x00,
+	0x49, 0x45, 0x4e, 0x44, 0xae, 0x42, 0x60, 0x82};
+
+TEST_CASE("probe tests", "[PNGPP]")
+{
+	auto info{probe(gray_3x2)};
+	REQUIRE(info.get_width() == 3);
+	REQUIRE(info.get_height() == 2);
+	REQUIRE(info.get_bit_depth() == 8);
+	REQUIRE(info.get_color_type() == color_type_gray);
+	REQUIRE(info.get_interlace_type() == interlace_none);
+
+	image_info unused;
+	REQUIRE_FALSE(try_probe(::std::span(gray_3x2).first(probe_size - 1), unused));
+
+	auto corrupt{gray_3x2};
+	corrupt[24] = 3; // bit depth 3 is not valid for any color type
+	REQUIRE_FALSE(try_probe(corrupt, unused));
+	REQUIRE_THROWS_AS(probe(corrupt), error);
+}
+
+TEST_CASE("chunk scanner tests", "[PNGPP]")
+{
+	auto index{scan_chunks(gray_3x2)};
+	REQUIRE(index.info.get_width() == 3);
+	REQUIRE(index.chunks.size() == 4);
+	REQUIRE(index.chunks[1].chunk.type == chunk_type_tEXt);
+	REQUIRE(index.chunks[2].chunk.offset == 56);
+	REQUIRE(index.has_iend);
+	REQUIRE_FALSE(index.is_truncated);
+	REQUIRE(index.is_crc_ok());
+
+	REQUIRE(index.idat_runs.size() == 1);
+	REQUIRE(index.idat_runs[0].begin == 56);
+	REQUIRE(index.idat_runs[0].end == 84);
+	REQUIRE(index.idat_runs[0].data_size == 16);
+
+	REQUIRE(index.texts.size() == 1);
+	REQUIRE(index.texts[0].keyword == "Title");
+	REQUIRE(index.texts[0].text == "png++");
+
+	auto corrupt{gray_3x2};
+	corrupt[66] ^= 0xff; // inside the IDAT data
+	REQUIRE_FALSE(scan_chunks(corrupt).is_crc_ok());
+	REQUIRE(scan_chunks(corrupt, scan_options{false}).is_crc_ok());
+
+	auto cut{scan_chunks(::std::span(gray_3x2).first(70))};
+	REQUIRE(cut.is_truncated);
+	REQUIRE_FALSE(cut.has_iend);
+	REQUIRE(cut.chunks.size() == 2);
+}
+
+TEST_CASE("strip encoder tests", "[PNGPP]")
+{
+	image_info info{make_image_info<rgb_pixel>()};
+	info.set_width(61);
+	info.set_height(47);
+	const size_t rowbytes{info.get_rowbytes()};
+
+	::std::vector<byte> pixels(rowbytes * info.get_height());
+	for (size_t i{0}; i < pixels.size(); ++i)
+	{
+		pixels[i] = static_cast<byte>(i % rowbytes + i / rowbytes * 3);
+	}
+	auto get_row = [&pixels, rowbytes](size_t pos){ return pixels.data() + pos * rowbytes; };
+
+	auto encode = [&](size_t thread_count)
+	{
+		strip_encoder encoder(info, strip_options{5, thread_count});
+		::std::vector<byte> stream;
+		encoder.encode(get_row, [&stream](::std::span<const byte> bytes){ stream.insert(stream.end(), bytes.begin(), bytes.end()); });
+		return stream;
+	};
+
+	auto single{encode(1)};
+	REQUIRE(single == encode(4));
+
+	::std::vector<byte> filtered((rowbytes + 1) * info.get_height());
+	uLongf size{static_cast<uLongf>(filtered.size())};
+	REQUIRE(::uncompress(filtered.data(), &size, single.data(), static_cast<uLong>(single.size())) == Z_OK);
+	REQUIRE(size == filtered.size());
+
+	::std::vector<byte> prev(rowbytes);
+	for (size_t pos{0}; pos < info.get_height(); ++pos)
+	{
+		byte* row{filtered.data() + pos * (rowbytes + 1)};
+		detail::unfilter_row(row[0], row + 1, prev.data(), rowbytes, get_filter_bpp(info));
+		REQUIRE(::std::equal(row + 1, row + 1 + rowbytes, get_row(pos)));
+		::std::copy(row + 1, row + 1 + rowbytes, prev.begin());
+	}
+}
+
+// a 40x33 RGB image the way strip_encoder::write() lays it out with split points, minus libpng's header chunks
+static ::std::vector<byte> make_split_png(const ::std::vector<byte>& pixels, size_t rowbytes)
+{
+	image_info info{make_image_info<rgb_pixel>()};
+	info.set_width(40);
+	info.set_height(33);
+
+	strip_options options;
+	options.strip_rows = 4;
+	options.split_points = true;
+	strip_encoder encoder(info, options);
+
+	vector_ostream<> png;
+	png.write(reinterpret_cast<const char*>(png_signature.data()), png_signature.size());
+	::std::array<byte, 13> ihdr{0, 0, 0, 40, 0, 0, 0, 33, 8, color_type_rgb, 0, 0, 0};
+	write_chunk(png, chunk_type_IHDR, ihdr);
+	::std::vector<byte> idat;
+	encoder.encode([&pixels, rowbytes](size_t pos){ return pixels.data() + pos * rowbytes; },
+		[&idat](::std::span<const byte> bytes){ idat.insert(idat.end(), bytes.begin(), bytes.end()); });
+	write_chunk(png, chunk_type_spIX, make_split_index(encoder.get_split_points()));
+	write_chunk(png, chunk_type_IDAT, ::std::span(idat).first(100));
+	write_chunk(png, chunk_type_IDAT, ::std::span(idat).subspan(100));
+	write_chunk(png, chunk_type_IEND, {});
+	return png.release();
+}
+
+static ::std::vector<byte> make_pixels(size_t rowbytes, size_t height)
+{
+	::std::vector<byte> pixels(rowbytes * height);
+	for (size_t i{0}; i < pixels.size(); ++i)
+	{
+		pixels[i] = static_cast<byte>((i % rowbytes) * (i / rowbytes) / 7);
+	}
+	return pixels;
+}
+
+TEST_CASE("split index tests", "[PNGPP]")
+{
+	const size_t rowbytes{40 * 3};
+	const auto pixels{make_pixels(rowbytes, 33)};
+	auto png{make_split_png(pixels, rowbytes)};
+
+	auto index{scan_chunks(png)};
+	auto points{find_split_points(index)};
+	REQUIRE(points.size() == 9);
+	REQUIRE(points[1].first_row == 4);
+
+	::std::vector<byte> decoded(pixels.size());
+	auto get_row = [&decoded, rowbytes](size_t pos){ return decoded.data() + pos * rowbytes; };
+	decode_split(index, points, get_row, 3);
+	REQUIRE(decoded == pixels);
+
+	png[png.size() - chunk_overhead - 5] ^= 1; // the Adler-32 of the zlib stream
+	auto corrupt{scan_chunks(png, scan_options{false})};
+	REQUIRE_THROWS_AS(decode_split(corrupt, points, get_row), error);
+}
+
+TEST_CASE("row index tests", "[PNGPP]")
+{
+	const size_t rowbytes{40 * 3};
+	const auto pixels{make_pixels(rowbytes, 33)};
+	const auto png{make_split_png(pixels, rowbytes)};
+	const auto chunks{scan_chunks(png)};
+
+	auto built{row_index::build(chunks, 8)};
+	REQUIRE(built.get_checkpoints().size() > 1);
+
+	const char* sidecar{"tests_row_index.idx"};
+	built.save(sidecar);
+	auto loaded{row_index::load(sidecar)};
+	REQUIRE(loaded.get_checkpoints().size() == built.get_checkpoints().size());
+
+	// corrupt sidecars: the sizes and positions of a checkpoint must fit the image
+	::std::vector<byte> saved(::std::filesystem::file_size(sidecar));
+	::std::ifstream(sidecar, ::std::ios::binary).read(reinterpret_cast<char*>(saved.data()), static_cast<::std::streamsize>(saved.size()));
+	const size_t entry{8 + 4 * 3 + 2 + 8 + 4 * 3};
+	const size_t second{entry + 33 + load_be32(saved.data() + entry + 29)};
+	auto load_corrupt = [&saved, sidecar](size_t offset, ::std::span<const byte> field)
+	{
+		auto corrupt{saved};
+		::std::copy(field.begin(), field.end(), corrupt.begin() + static_cast<::std::ptrdiff_t>(offset));
+		::std::ofstream(sidecar, ::std::ios::binary).write(reinterpret_cast<const char*>(corrupt.data()),
+			static_cast<::std::streamsize>(corrupt.size()));
+		REQUIRE_THROWS_AS(row_index::load(sidecar), error);
+	};
+	::std::array<byte, 4> size;
+	store_be32(size.data(), 1u << 31);
+	load_corrupt(second + 21, size);				// row above
+	store_be32(size.data(), static_cast<uint32_t>(rowbytes + 1));
+	load_corrupt(second + 25, size);				// partial row
+	store_be32(size.data(), 0xffffffff);
+	load_corrupt(second + 29, size);				// deflated snapshot
+	load_corrupt(second + 8, ::std::array<byte, 4>{0x7f});	// rows past the end
+	load_corrupt(entry, ::std::array<byte, 17>{0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1});	// bits of the byte before 0
+	::std::remove(sidecar);
+
+	for (size_t first : {size_t{0}, size_t{5}, size_t{17}, size_t{30}})
+	{
+		::std::vector<byte> band(3 * rowbytes);
+		loaded.read_rows(chunks, first, 3, [&band, first, rowbytes](size_t pos){ return band.data() + (pos - first) * rowbytes; });
+		REQUIRE(::std::equal(band.begin(), band.end(), pixels.begin() + first * rowbytes));
+	}
+	REQUIRE_THROWS_AS(loaded.read_rows(chunks, 31, 3, [](size_t){ return static_cast<byte*>(nullptr); }), error);
+}
+
+TEST_CASE("fast encoder tests", "[PNGPP]")
+{
+	// 300x500 RGBA is about two batches: matches reach back across the slid window
+	image_info info{make_image_info<rgba_pixel>()};
+	info.set_width(300);
+	info.set_height(500);
+	const size_t rowbytes{300 * 4};
+	auto pixels{make_pixels(rowbytes, 500)};
+	uint32_t seed{1};
+	for (size_t i{pixels.size() / 3}; i < pixels.size() / 2; ++i)
+	{
+		seed = seed * 1103515245 + 12345;
+		pixels[i] = static_cast<byte>(seed >> 24);
+	}
+
+	REQUIRE(fast_encoder::is_supported(info));
+	fast_encoder encoder(info);
+	::std::vector<byte> idat;
+	encoder.encode([&pixels, rowbytes](size_t pos){ return pixels.data() + pos * rowbytes; },
+		[&idat](::std::span<const byte> bytes){ idat.insert(idat.end(), bytes.begin(), bytes.end()); });
+	REQUIRE(idat.size() < pixels.size());
+
+	vector_ostream<> png;
+	png.write(reinterpret_cast<const char*>(png_signature.data()), png_signature.size());
+	::std::array<byte, 13> ihdr{0, 0, 0x01, 0x2c, 0, 0, 0x01, 0xf4, 8, color_type_rgba, 0, 0, 0};
+	write_chunk(png, chunk_type_IHDR, ihdr);
+	write_chunk(png, chunk_type_IDAT, idat);
+	write_chunk(png, chunk_type_IEND, {});
+	const auto bytes{png.release()};
+
+	::std::vector<byte> decoded(pixels.size());
+	decode_native(scan_chunks(bytes), [&decoded, rowbytes](size_t pos){ return decoded.data() + pos * rowbytes; });
+	REQUIRE(decoded == pixels);
+
+	info.set_bit_depth(16);
+	REQUIRE_FALSE(fast_encoder::is_supported(info));
+	REQUIRE_THROWS_AS(fast_encoder(info), error);
+}
+
+TEST_CASE("native decoder tests", "[PNGPP]")
+{
+	for (size_t bpp : {size_t{1}, size_t{3}, size_t{4}})
+	{
+		const size_t rowbytes{bpp * 37};
+		const auto prev{make_pixels(rowbytes, 2)};
+		for (int filter{row_filter_none}; filter <= row_filter_paeth; ++filter)
+		{
+			::std::vector<byte> expected(prev.begin() + rowbytes, prev.end());
+			auto actual{expected};
+			detail::unfilter_row(filter, expected.data(), prev.data(), rowbytes, bpp);
+			detail::unfilter_row_fast(filter, actual.data(), prev.data(), rowbytes, bpp);
+			REQUIRE(actual == expected);
+
+			const ::std::vector<byte> zeros(rowbytes);
+			::std::vector<byte> first(prev.begin(), prev.begin() + rowbytes);
+			auto first_actual{first};
+			detail::unfilter_row(filter, first.data(), zeros.data(), rowbytes, bpp);
+			detail::unfilter_first_row(filter, first_actual.data(), rowbytes, bpp);
+			REQUIRE(first_actual == first);
+		}
+	}
+
+	const size_t rowbytes{40 * 3};
+	const auto pixels{make_pixels(rowbytes, 33)};
+	auto png{make_split_png(pixels, rowbytes)};
+	const auto chunks{scan_chunks(png)};
+	REQUIRE(detail::can_decode_native<rgb_pixel>(chunks));
+	REQUIRE_FALSE(detail::can_decode_native<rgba_pixel>(chunks));
+
+	::std::vector<byte> decoded(pixels.size());
+	decode_native(chunks, [&decoded, rowbytes](size_t pos){ return decoded.data() + pos * rowbytes; });
+	REQUIRE(decoded == pixels);
+
+	::std::vector<byte> solid;
+	decode_native_whole(chunks, solid);
+	REQUIRE(solid == pixels);
+
+	solid_pixel_buffer<rgb_pixel> buffer(40, 33);
+	REQUIRE(buffer.get_stride() == rowbytes);
+	decode_native_whole(chunks, buffer.get_storage());
+	REQUIRE(::std::equal(pixels.begin(), pixels.end(), reinterpret_cast<const byte*>(buffer.get_row(0))));
+	REQUIRE(buffer.get_row_pointers()[32] == reinterpret_cast<byte*>(buffer[32]));
+
+	// a damaged Adler-32 only shows once the whole stream is inflated
+	png[png.size() - 17] ^= 1;
+	const auto damaged{scan_chunks(png, {.verify_crc = false})};
+	REQUIRE_THROWS_AS(decode_native(damaged, [&decoded, rowbytes](size_t pos){ return decoded.data() + pos * rowbytes; }), error);
+	REQUIRE_THROWS_AS(decode_native_whole(damaged, solid), error);
+}
+
+TEST_CASE("checksum tests", "[PNGPP]")
+{
+	::std::vector<byte> bytes(1 << 16);
+	uint32_t seed{1};
+	for (auto& b : bytes)
+	{
+		seed = seed * 1103515245 + 12345;
+		b = static_cast<byte>(seed >> 24);
+	}
+
+	// every length around the block sizes of the kernels, at every alignment
+	bool same{true};
+	for (size_t offset{0}; offset < 16; ++offset)
+	{
+		for (size_t size{0}; size < 300; ++size)
+		{
+			const auto piece{::std::span<const byte>(bytes).subspan(offset, size)};
+			same = same && crc32(piece) == ::crc32(0, piece.data(), static_cast<uInt>(size))
+				&& adler32(piece) == ::adler32(1, piece.data(), static_cast<uInt>(size));
+		}
+	}
+	REQUIRE(same);
+
+	// continued from a previous value; all 0xff is the worst case for the Adler-32 sums
+	REQUIRE(crc32(bytes, 0x12345678) == ::crc32(0x12345678, bytes.data(), static_cast<uInt>(bytes.size())));
+	REQUIRE(adler32(bytes, 0xfff0fff0) == ::adler32(0xfff0fff0, bytes.data(), static_cast<uInt>(bytes.size())));
+	const ::std::vector<byte> ones(1 << 16, 0xff);
+	REQUIRE(adler32(ones, 0xfff0fff0) == ::adler32(0xfff0fff0, ones.data(), static_cast<uInt>(ones.size())));
+	REQUIRE(crc32(::std::span(bytes).subspan(1000), crc32(::std::span(bytes).first(1000))) == crc32(bytes));
+
+#if defined(PNGPP_CPU_DISPATCH_SUPPORTED)
+	// each kernel, whatever get_cpu_features() would pick
+	if (get_cpu_features().ssse3)
+	{
+		REQUIRE(detail::adler32_ssse3(1, ones.data(), ones.size()) == ::adler32(1, ones.data(), static_cast<uInt>(ones.size())));
+		REQUIRE(detail::adler32_ssse3(1, bytes.data() + 3, 1001) == ::adler32(1, bytes.data() + 3, 1001));
+	}
+	if (get_cpu_features().avx2)
+	{
+		REQUIRE(detail::adler32_avx2(1, ones.data(), ones.size()) == ::adler32(1, ones.data(), static_cast<uInt>(ones.size())));
+		REQUIRE(detail::adler32_avx2(1, bytes.data() + 3, 1001) == ::adler32(1, bytes.data() + 3, 1001));
+	}
+#endif
+
+	REQUIRE(scan_chunks(gray_3x2).is_crc_ok());
+}
+
+static inline ::std::vector<chunk_type> get_chunk_types(::std::span<const byte> png)
+{
+	::std::vector<chunk_type> types;
+	for (const auto& record : scan_chunks(png).chunks)
+	{
+		types.push_back(record.chunk.type);
+	}
+	return types;
+}
+
+TEST_CASE("chunk editor tests", "[PNGPP]")
+{
+	// untouched, the data stream comes out as it went in
+	chunk_editor unchanged(gray_3x2);
+	vector_ostream<> same;
+	unchanged.write_stream(same);
+	REQUIRE(::std::ranges::equal(same.get_bytes(), gray_3x2));
+	REQUIRE(unchanged.contains(chunk_type_tEXt));
+	REQUIRE(unchanged.get_data(chunk_type_IDAT).size() == 16);
+
+	chunk_editor editor(gray_3x2);
+	editor.set_text("Title", "edited");
+	editor.add_text("Author", "png++");
+	editor.set_gamma(1 / 2.2);
+	editor.set_pHYs({2835, 2835, 1});
+	editor.strip(chunk_type_eXIf);
+	vector_ostream<> edited;
+	editor.write_stream(edited);
+
+	const auto index{scan_chunks(edited.get_bytes())};
+	REQUIRE(index.is_crc_ok());
+	REQUIRE(get_chunk_types(edited.get_bytes()) == ::std::vector<chunk_type>{chunk_type_IHDR, chunk_type_tEXt, chunk_type_tEXt,
+		chunk_type_gAMA, chunk_type_pHYs, chunk_type_IDAT, chunk_type_IEND});
+	REQUIRE(index.texts.size() == 2);
+	REQUIRE(index.texts[0].keyword == "Title");
+	REQUIRE(index.texts[0].text == "edited");
+	REQUIRE(index.texts[1].text == "png++");
+	REQUIRE(index.phys->x == 2835);
+	REQUIRE(load_be32(index.find(chunk_type_gAMA)->chunk.data.data()) == 45455);
+
+	// the image data is copied byte for byte, CRC included
+	const auto& idat{index.find(chunk_type_IDAT)->chunk};
+	REQUIRE(::std::ranges::equal(edited.get_bytes().subspan(idat.offset, idat.get_size()), ::std::span(gray_3x2).subspan(56, 28)));
+
+	editor.strip_text("Title");
+	editor.set_iCCP("profile", ::std::vector<byte>(300, 7));
+	vector_ostream<> profiled;
+	editor.write_stream(profiled);
+	const auto with_profile{scan_chunks(profiled.get_bytes())};
+	REQUIRE(with_profile.texts.size() == 1);
+	REQUIRE(with_profile.iccp->name == "profile");
+	editor.set_sRGB(0);
+	REQUIRE(editor.contains(chunk_type_sRGB));
+	REQUIRE_FALSE(editor.contains(chunk_type_iCCP));
+	editor.strip_text();
+	REQUIRE_FALSE(editor.contains(chunk_type_tEXt));
+
+	REQUIRE_THROWS_AS(editor.set(chunk_type_IDAT, {}), error);
+	REQUIRE_THROWS_AS(editor.set_text("", "x"), error);
+	REQUIRE_THROWS_AS(chunk_editor(::std::span(gray_3x2).first(70)), error);
+
+	// a palette swap: 2x1, entries 0 and 1, with entry 1 transparent
+	vector_ostream<> indexed;
+	indexed.write(reinterpret_cast<const char*>(png_signature.data()), png_signature.size());
+	const ::std::array<byte, 13> ihdr{0, 0, 0, 2, 0, 0, 0, 1, 8, color_type_palette, 0, 0, 0};
+	const ::std::array<byte, 6> plte{10, 20, 30, 40, 50, 60};
+	const ::std::array<byte, 2> trns{255, 0};
+	const ::std::array<byte, 3> row{0, 0, 1};
+	::std::array<byte, 64> idat_data;
+	uLongf idat_size{idat_data.size()};
+	REQUIRE(::compress(idat_data.data(), &idat_size, row.data(), row.size()) == Z_OK);
+	write_chunk(indexed, chunk_type_IHDR, ihdr);
+	write_chunk(indexed, chunk_type_PLTE, plte);
+	write_chunk(indexed, chunk_type_tRNS, trns);
+	write_chunk(indexed, chunk_type_IDAT, ::std::span(idat_data).first(idat_size));
+	write_chunk(indexed, chunk_type_IEND, {});
+
+	chunk_editor swap(indexed.get_bytes());
+	swap.set_palette({color(1, 2, 3), color(4, 5, 6)});
+	swap.set_tRNS({0, 255});
+	swap.set_gamma(0.5);
+	REQUIRE_THROWS_AS(swap.strip(chunk_type_PLTE), error);
+	vector_ostream<> swapped;
+	swap.write_stream(swapped);
+	REQUIRE(get_chunk_types(swapped.get_bytes()) == ::std::vector<chunk_type>{chunk_type_IHDR, chunk_type_gAMA, chunk_type_PLTE,
+		chunk_type_tRNS, chunk_type_IDAT, chunk_type_IEND});
+
+	image_info info;
+	detail::fill_info(info, scan_chunks(swapped.get_bytes()));
+	REQUIRE(info.get_palette().size() == 2);
+	REQUIRE(info.get_palette()[1].green == 5);
+	REQUIRE(info.get_tRNS() == tRNS{0, 255});
+	::std::array<byte, 2> indices;
+	decode_native(scan_chunks(swapped.get_bytes()), [&indices](size_t){ return indices.data(); });
+	REQUIRE(indices == ::std::array<byte, 2>{0, 1});
+}
+
+TEST_CASE("checksum benchmarks", "[PNGPP][.benchmark]")
+{
+	const ::std::vector<byte> bytes(1 << 20, 0x5a);
+	BENCHMARK("zlib crc32")
+	{
+		return ::crc32(0, bytes.data(), static_cast<uInt>(bytes.size()));
+	};
+	BENCHMARK("png::crc32")
+	{
+		return crc32(bytes);
+	};
+	BENCHMARK("zlib adler32")
+	{
+		return ::adler32(1, bytes.data(), static_cast<uInt>(bytes.size()));
+	};
+	BENCHMARK("png::adler32")
+	{
+		return adler32(bytes);
+	};
+}
+
+} // namespace png::testing
@@ -0,0 +1,549 @@
+/**********************************************************************************************************************************************\
+	Copyright© 2021 Mason DeRoss
+
+	Released under either the GNU All-permissive License or MIT license. You pick.
+
+	Copying and distribution of this file, with or without modification, are permitted in any medium without royalty,
+	provided the copyright notice and this notice are preserved. This file is offered as-is, without any warranty.
+
+	DESCRIPTION:
+		Tests for the decoding paths other than a plain image::read(), each one checked against image::read().
+
+\**********************************************************************************************************************************************/
+//#include "../include/stdafx.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../include/png.hpp"
+#include "../include/vector_ostream.hpp"
+
+#include "tests.h"
+
+namespace png::testing
+{
+
+TEST_CASE("worker threads tests", "[PNGPP]")
+{
+	::std::array<::std::atomic<int>, 4> calls{};
+	detail::run_workers(calls.size(), [&calls](size_t t){ ++calls[t]; });
+	REQUIRE(::std::ranges::all_of(calls, [](const ::std::atomic<int>& c){ return c == 1; }));
+
+	// an exception on the calling thread leaves after the other threads are joined, instead of terminating
+	::std::atomic<int> finished{0};
+	REQUIRE_THROWS_AS(detail::run_workers(3, [&finished](size_t t)
+	{
+		if (t == 0)
+		{
+			throw error("worker 0");
+		}
+		::std::this_thread::sleep_for(::std::chrono::milliseconds(10));
+		++finished;
+	}), error);
+	REQUIRE(finished == 2);
+}
+
+TEST_CASE("batch decoder tests", "[PNGPP]")
+{
+	::std::vector<image<rgb_pixel>> expected;
+	::std::vector<::std::vector<byte>> pngs;
+	::std::vector<::std::string> filenames;
+	for (uint32_t i{0}; i < 5; ++i)
+	{
+		expected.push_back(make_test_image(20 + i * 7, 10 + i * 3, i));
+		pngs.push_back(encode(expected.back()));
+		filenames.push_back("tests_batch_" + ::std::to_string(i) + ".png");
+		expected.back().write(filenames.back().c_str(), encode_options());
+	}
+	filenames.push_back("tests_batch_missing.png");
+
+	batch_decoder<rgb_pixel> decoder(3);
+	::std::mutex lock;
+	::std::vector<bool> matched(filenames.size());
+	::std::vector<bool> failed(filenames.size());
+	auto check = [&](size_t index, image<rgb_pixel>& img, ::std::exception_ptr error)
+	{
+		const ::std::scoped_lock guard(lock);
+		failed[index] = error != nullptr;
+		matched[index] = !error && same_pixels(img, expected[index]);
+	};
+
+	// as in the documentation: a span of the names
+	decoder.decode(::std::span(filenames), check);
+	for (size_t i{0}; i < expected.size(); ++i)
+	{
+		REQUIRE(matched[i]);
+		::std::remove(filenames[i].c_str());
+	}
+	REQUIRE(failed.back());
+
+	// in-memory data, straight from the vector
+	::std::fill(matched.begin(), matched.end(), false);
+	decoder.decode(pngs, check);
+	REQUIRE(::std::count(matched.begin(), matched.end(), true) == static_cast<::std::ptrdiff_t>(pngs.size()));
+
+	// any other transformation goes through the reader
+	::std::fill(matched.begin(), matched.end(), false);
+	decoder.decode(pngs, check, [](auto& io){ convert_color_space<rgb_pixel>()(io); });
+	REQUIRE(::std::count(matched.begin(), matched.end(), true) == static_cast<::std::ptrdiff_t>(pngs.size()));
+}
+
+// collects the rows push_consumer delivers into an image, interlaced passes combined
+class push_sink : public push_consumer<rgb_pixel, push_sink, def_image_info_holder, /* interlacing = */ true>
+{
+public:
+	explicit inline push_sink(image_info& info) : push_consumer(info) {}
+
+	inline void reset(size_t pass)
+	{
+		if (pass == 0)
+		{
+			m_image.resize(get_info().get_width(), get_info().get_height());
+		}
+	}
+
+	inline byte* get_next_row(uint32_t pos)
+	{
+		using row_traits = pixel_buffer<rgb_pixel>::row_traits;
+		return reinterpret_cast<byte*>(row_traits::get_data(m_image.get_pixbuf().get_row(pos)));
+	}
+
+	inline const image<rgb_pixel>& get_image() const noexcept
+	{
+		return m_image;
+	}
+
+private:
+	image<rgb_pixel> m_image;
+};
+
+TEST_CASE("push reader tests", "[PNGPP]")
+{
+	auto img{make_test_image(61, 37)};
+	const auto plain{encode(img)};
+	img.set_interlace_type(interlace_adam7);
+	const auto interlaced{encode(img)};
+
+	for (const auto& png : {plain, interlaced})
+	{
+		image<rgb_pixel> expected;
+		expected.read(::std::span<const byte>(png));
+
+		// one byte at a time
+		image_info info;
+		push_sink bytewise(info);
+		for (size_t i{0}; i < png.size(); ++i)
+		{
+			REQUIRE_FALSE(bytewise.is_done());
+			bytewise.feed(::std::span(png).subspan(i, 1));
+		}
+		REQUIRE(bytewise.is_done());
+		REQUIRE(same_pixels(bytewise.get_image(), expected));
+
+		// pieces of random size, empty ones included
+		push_sink pieces(info);
+		uint32_t seed{1};
+		for (size_t pos{0}; pos < png.size();)
+		{
+			seed = seed * 1103515245 + 12345;
+			const size_t size{::std::min<size_t>((seed >> 16) % 300, png.size() - pos)};
+			pieces.feed(::std::span(png).subspan(pos, size));
+			pos += size;
+		}
+		REQUIRE(pieces.is_done());
+		REQUIRE(same_pixels(pieces.get_image(), expected));
+
+		// a truncated stream is not done, a corrupt one throws
+		push_sink truncated(info);
+		truncated.feed(::std::span(png).first(png.size() / 2));
+		REQUIRE_FALSE(truncated.is_done());
+
+		auto bad{png};
+		bad[png.size() / 2] ^= 0xff;
+		push_sink corrupt(info);
+		REQUIRE_THROWS_AS(corrupt.feed(bad), error);
+	}
+}
+
+// the consumer counterpart of push_sink, read a number of rows at a time with begin_read(); a banded sink is a row_band_provider
+template<bool banded = false>
+class consumer_sink : public consumer<rgb_pixel, consumer_sink<banded>, def_image_info_holder, /* interlacing = */ true>
+{
+public:
+	using base = consumer<rgb_pixel, consumer_sink, def_image_info_holder, true>;
+
+	explicit inline consumer_sink(image_info& info) : base(info) {}
+
+	inline void reset(size_t pass)
+	{
+		if (pass == 0)
+		{
+			m_image.resize(this->get_info().get_width(), this->get_info().get_height());
+		}
+	}
+
+	inline byte* get_next_row(size_t pos)
+	{
+		using row_traits = pixel_buffer<rgb_pixel>::row_traits;
+		return reinterpret_cast<byte*>(row_traits::get_data(m_image.get_pixbuf().get_row(pos)));
+	}
+
+	inline void get_next_rows(size_t pos, size_t count, byte** rows) requires banded
+	{
+		++m_bands;
+		for (size_t i{0}; i < count; ++i)
+		{
+			rows[i] = get_next_row(pos + i);
+		}
+	}
+
+	inline const image<rgb_pixel>& get_image() const noexcept
+	{
+		return m_image;
+	}
+
+	inline size_t get_bands() const noexcept
+	{
+		return m_bands;
+	}
+
+private:
+	image<rgb_pixel> m_image;
+	size_t m_bands{0};
+};
+
+// writes the rows of an image, a row or a band at a time
+template<bool banded = false>
+class generator_source : public generator<rgb_pixel, generator_source<banded>, def_image_info_holder, /* interlacing = */ true>
+{
+public:
+	using base = generator<rgb_pixel, generator_source, def_image_info_holder, true>;
+
+	explicit inline generator_source(image<rgb_pixel>& img) : base(img.get_width(), img.get_height()), m_image(img)
+	{
+		this->get_info().set_interlace_type(img.get_interlace_type());
+	}
+
+	inline byte* get_next_row(size_t pos)
+	{
+		using row_traits = pixel_buffer<rgb_pixel>::row_traits;
+		return reinterpret_cast<byte*>(row_traits::get_data(m_image.get_pixbuf().get_row(pos)));
+	}
+
+	inline void get_next_rows(size_t pos, size_t count, byte** rows) requires banded
+	{
+		++m_bands;
+		for (size_t i{0}; i < count; ++i)
+		{
+			rows[i] = get_next_row(pos + i);
+		}
+	}
+
+	inline size_t get_bands() const noexcept
+	{
+		return m_bands;
+	}
+
+private:
+	image<rgb_pixel>& m_image;
+	size_t m_bands{0};
+};
+
+TEST_CASE("incremental read tests", "[PNGPP]")
+{
+	auto img{make_test_image(53, 37)};
+	const auto plain{encode(img)};
+	img.set_interlace_type(interlace_adam7);
+	const auto interlaced{encode(img)};
+
+	for (const auto& png : {plain, interlaced})
+	{
+		image<rgb_pixel> expected;
+		expected.read(::std::span<const byte>(png));
+		const size_t pass_count{png == plain ? size_t{1} : size_t{7}};
+
+		// 7 rows a step: every step but the last leaves rows to read, and the position moves on by 7 rows each time
+		image_info info;
+		consumer_sink<> stepwise(info);
+		span_istream stream(png);
+		auto job{stepwise.begin_read(stream)};
+		REQUIRE(job.get_pass() == 0);
+		REQUIRE(job.get_position() == 0);
+		size_t steps{1};
+		while (job.step(7))
+		{
+			REQUIRE((job.get_pass() * 37 + job.get_position()) == steps * 7);
+			++steps;
+		}
+		REQUIRE(steps == (pass_count * 37 + 6) / 7);
+		REQUIRE(job.done());
+		REQUIRE_FALSE(job.step(7));
+		REQUIRE(same_pixels(stepwise.get_image(), expected));
+
+		// a few steps, then the rest in one go
+		consumer_sink<> finished(info);
+		span_istream again(png);
+		auto rest{finished.begin_read(again)};
+		REQUIRE(rest.step(1));
+		REQUIRE(rest.step(20));
+		rest.finish();
+		REQUIRE(rest.done());
+		REQUIRE(same_pixels(finished.get_image(), expected));
+
+		// errors come out of the step that reads the bad row
+		auto bad{png};
+		bad.resize(png.size() * 2 / 3);
+		consumer_sink<> cut(info);
+		span_istream short_stream(bad);
+		auto failing{cut.begin_read(short_stream)};
+		REQUIRE_THROWS_AS(failing.finish(), error);
+	}
+}
+
+TEST_CASE("row band tests", "[PNGPP]")
+{
+	static_assert(row_band_provider<consumer_sink<true>> && !row_band_provider<consumer_sink<false>>);
+	static_assert(row_band_provider<generator_source<true>> && !row_band_provider<generator_source<false>>);
+
+	// less than a band, and a height that leaves a partial band at the bottom
+	for (uint32_t height : {uint32_t{37}, static_cast<uint32_t>(2 * row_band_size + 13)})
+	{
+		for (auto interlace : {interlace_none, interlace_adam7})
+		{
+			auto img{make_test_image(45, height)};
+			img.set_interlace_type(interlace);
+			const size_t pass_count{interlace == interlace_none ? size_t{1} : size_t{7}};
+			const size_t bands{pass_count * ((height + row_band_size - 1) / row_band_size)};
+
+			generator_source<> by_row(img);
+			vector_ostream<> row_png;
+			by_row.write(row_png);
+			generator_source<true> by_band(img);
+			vector_ostream<> band_png;
+			by_band.write(band_png);
+			REQUIRE(by_band.get_bands() == bands);
+			REQUIRE(::std::ranges::equal(band_png.get_bytes(), row_png.get_bytes()));
+
+			image<rgb_pixel> expected;
+			expected.read(band_png.get_bytes());
+			REQUIRE(same_pixels(expected, img));
+
+			image_info row_info;
+			consumer_sink<> row_sink(row_info);
+			row_sink.read(row_png.get_bytes());
+			image_info band_info;
+			consumer_sink<true> band_sink(band_info);
+			band_sink.read(row_png.get_bytes());
+			REQUIRE(band_sink.get_bands() == bands);
+			REQUIRE(same_pixels(row_sink.get_image(), expected));
+			REQUIRE(same_pixels(band_sink.get_image(), expected));
+		}
+	}
+}
+
+TEST_CASE("file read tests", "[PNGPP]")
+{
+	auto img{make_test_image(50, 30)};
+	const auto png{encode(img)};
+	const char* filename{"tests_file_read.png"};
+	::std::ofstream(filename, ::std::ios::binary).write(reinterpret_cast<const char*>(png.data()), static_cast<::std::streamsize>(png.size()));
+
+	{
+		mapped_file file(filename);
+		REQUIRE(file.size() == png.size());
+		REQUIRE(::std::ranges::equal(file.get_bytes(), png));
+	}
+
+	// the native decoder, the libpng reader over the mapped bytes, and the reader through a transformation
+	image<rgb_pixel> native;
+	native.read(filename);
+	REQUIRE(same_pixels(native, img));
+	image<rgb_pixel> checked;
+	{
+		mapped_file file(filename);
+		span_istream stream(file.get_bytes());
+		checked.read_stream(stream);
+	}
+	REQUIRE(same_pixels(checked, img));
+	image<rgb_pixel> trusted;
+	trusted.read(filename, decode_options::trusted());
+	REQUIRE(same_pixels(trusted, img));
+	image<rgb_pixel> transformed;
+	transformed.read(filename, convert_color_space<rgb_pixel>());
+	REQUIRE(same_pixels(transformed, img));
+
+	// an empty file opens and maps to nothing, and is then no PNG
+	::std::ofstream(filename, ::std::ios::binary | ::std::ios::trunc).close();
+	{
+		mapped_file file(filename);
+		REQUIRE(file.size() == 0);
+		REQUIRE(file.get_bytes().empty());
+	}
+	image<rgb_pixel> empty;
+	REQUIRE_THROWS_AS(empty.read(filename), error);
+	REQUIRE_THROWS_AS(empty.read(filename, convert_color_space<rgb_pixel>()), error);
+	::std::remove(filename);
+
+	// a missing file is an IO error, whichever way it is read
+	REQUIRE_THROWS_AS(mapped_file(filename), std_error);
+	image<rgb_pixel> missing;
+	REQUIRE_THROWS_AS(missing.read(filename), std_error);
+	REQUIRE_THROWS_AS(missing.read(::std::string(filename)), std_error);
+	REQUIRE_THROWS_AS(missing.read(filename, decode_options()), std_error);
+	REQUIRE_THROWS_AS(missing.read(filename, convert_color_space<rgb_pixel>()), std_error);
+}
+
+TEST_CASE("async file tests", "[PNGPP]")
+{
+	auto img{make_test_image(70, 50)};
+	const char* filename{"tests_async_file.png"};
+	const auto expected{encode(img)};
+	size_t divisor{2};
+	while (expected.size() % divisor != 0)
+	{
+		++divisor;
+	}
+
+	// the default block size, one byte blocks, and blocks that divide the file exactly, so that an empty block marks its end
+	for (size_t block_size : {default_io_block_size, size_t{1}, expected.size(), expected.size() / divisor})
+	{
+		INFO(block_size);
+		{
+			async_file_ostream out(filename, block_size, 2);
+			img.write_stream(out);
+			out.flush();
+			REQUIRE(out.good());
+		}
+		REQUIRE(::std::filesystem::file_size(filename) == expected.size());
+
+		async_file_istream in(filename, block_size, 2);
+		image<rgb_pixel> decoded;
+		decoded.read_stream(in);
+		REQUIRE(same_pixels(decoded, img));
+
+		// the raw bytes, and nothing after them
+		async_file_istream raw(filename, block_size, 2);
+		::std::vector<char> bytes(expected.size());
+		raw.read(bytes.data(), bytes.size());
+		REQUIRE(raw.good());
+		REQUIRE(::std::equal(bytes.begin(), bytes.end(), reinterpret_cast<const char*>(expected.data())));
+		char past;
+		raw.read(&past, 1);
+		REQUIRE_FALSE(raw.good());
+	}
+	::std::remove(filename);
+
+	REQUIRE_THROWS_AS(async_file_istream(filename), std_error);
+	REQUIRE_THROWS_AS(async_file_ostream("tests_no_such_directory/out.png"), std_error);
+
+	// a directory opens on some systems but cannot be read: an error, not the end of the file
+	auto read_directory = []
+	{
+		async_file_istream dir(".");
+		char c;
+		dir.read(&c, 1);
+	};
+	REQUIRE_THROWS_AS(read_directory(), std_error);
+}
+
+// reads from memory like span_istream, counting the calls the way a costly stream would feel them
+class counting_istream
+{
+public:
+	explicit inline counting_istream(::std::span<const byte> bytes) noexcept : m_bytes(bytes) {}
+
+	inline void read(char* data, size_t length)
+	{
+		++m_calls;
+		m_gcount = ::std::min(length, m_bytes.size() - m_pos);
+		::std::memcpy(data, m_bytes.data() + m_pos, m_gcount);
+		m_pos += m_gcount;
+		m_good = m_gcount == length;
+	}
+
+	inline bool good() const noexcept
+	{
+		return m_good;
+	}
+
+	inline ::std::streamsize gcount() const noexcept
+	{
+		return static_cast<::std::streamsize>(m_gcount);
+	}
+
+	inline size_t get_calls() const noexcept
+	{
+		return m_calls;
+	}
+
+private:
+	::std::span<const byte> m_bytes;
+	size_t m_pos{0};
+	size_t m_gcount{0};
+	size_t m_calls{0};
+	bool m_good{true};
+};
+
+TEST_CASE("buffered istream tests", "[PNGPP]")
+{
+	auto img{make_test_image(160, 120)};
+	const auto png{encode(img)};
+	REQUIRE(png.size() > 5 * 1024);
+
+	// libpng reads every chunk header and CRC on its own; through the buffer the stream sees one read per block
+	counting_istream direct(png);
+	image<rgb_pixel> expected;
+	expected.read_stream(direct);
+	REQUIRE(same_pixels(expected, img));
+
+	const size_t block_size{1024};
+	counting_istream counted(png);
+	buffered_istream<counting_istream> buffered(counted, block_size);
+	image<rgb_pixel> decoded;
+	decoded.read_stream(buffered);
+	REQUIRE(same_pixels(decoded, img));
+	REQUIRE(counted.get_calls() <= png.size() / block_size + 1);
+	REQUIRE(counted.get_calls() < direct.get_calls());
+
+	// the last block is short; the bytes in it are still served, and a read past them fails
+	REQUIRE(png.size() % block_size != 0);
+	counting_istream whole(png);
+	buffered_istream<counting_istream> blocks(whole, block_size);
+	::std::vector<char> bytes(png.size());
+	for (size_t pos{0}; pos < bytes.size(); pos += 100)
+	{
+		blocks.read(bytes.data() + pos, ::std::min<size_t>(100, bytes.size() - pos));
+		REQUIRE(blocks.good());
+	}
+	REQUIRE(::std::equal(bytes.begin(), bytes.end(), reinterpret_cast<const char*>(png.data())));
+	REQUIRE(whole.get_calls() == png.size() / block_size + 1);
+	char past;
+	blocks.read(&past, 1);
+	REQUIRE_FALSE(blocks.good());
+
+	// requests of a block or more go straight to the stream, without filling the buffer first
+	counting_istream large(png);
+	buffered_istream<counting_istream> bypass(large, block_size);
+	bypass.read(bytes.data(), block_size);
+	REQUIRE(large.get_calls() == 1);
+	bypass.read(bytes.data() + block_size, 3 * block_size);
+	REQUIRE(large.get_calls() == 2);
+	REQUIRE(::std::equal(bytes.begin(), bytes.begin() + 4 * block_size, reinterpret_cast<const char*>(png.data())));
+	bypass.read(bytes.data() + 4 * block_size, 10);
+	REQUIRE(large.get_calls() == 3);
+	REQUIRE(bypass.good());
+}
+
+} // namespace png::testing
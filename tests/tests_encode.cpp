@@ -0,0 +1,440 @@
+/**********************************************************************************************************************************************\
+	Copyright© 2021 Mason DeRoss
+
+	Released under either the GNU All-permissive License or MIT license. You pick.
+
+	Copying and distribution of this file, with or without modification, are permitted in any medium without royalty,
+	provided the copyright notice and this notice are preserved. This file is offered as-is, without any warranty.
+
+	DESCRIPTION:
+		Tests and benchmarks for the writer's compression settings and the readers' integrity checks.
+
+\**********************************************************************************************************************************************/
+//#include "../include/stdafx.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <string_view>
+#include <utility>
+
+#include "../include/png.hpp"
+#include "../include/encode_options.hpp"
+#include "../include/decode_options.hpp"
+#include "../include/chunk_editor.hpp"
+#include "../include/filter_chooser.hpp"
+#include "../include/strip_encoder.hpp"
+#include "../include/validate.hpp"
+#include "../include/vector_ostream.hpp"
+
+#include "tests.h"
+
+namespace png::testing
+{
+
+static inline constexpr ::std::array<::std::pair<::std::string_view, encode_options>, 5> encode_presets{{
+	{"default", encode_options()},
+	{"fastest", encode_options::fastest()},
+	{"balanced", encode_options::balanced()},
+	{"smallest", encode_options::smallest()},
+	{"low_memory", encode_options::low_memory()}}};
+
+TEST_CASE("encode options tests", "[PNGPP]")
+{
+	auto img{make_test_image(640, 480)};
+	::std::array<size_t, encode_presets.size()> sizes{};
+	for (size_t i{0}; i < encode_presets.size(); ++i)
+	{
+		const auto bytes{encode(img, encode_presets[i].second)};
+		sizes[i] = bytes.size();
+
+		INFO(encode_presets[i].first);
+		REQUIRE(same_pixels(image<rgb_pixel>(bytes), img));
+	}
+
+	// fastest spends the least effort, so neither smallest nor balanced comes out larger
+	REQUIRE(sizes[3] <= sizes[1]);
+	REQUIRE(sizes[2] <= sizes[1]);
+}
+
+TEST_CASE("write error tests", "[PNGPP]")
+{
+	// the errors reach the caller instead of terminating
+	auto img{make_test_image(640, 480)};
+	REQUIRE_THROWS_AS(img.write("tests_no_such_directory/out.png"), std_error);
+	REQUIRE_THROWS_AS(img.write(::std::string("tests_no_such_directory/out.png")), std_error);
+
+	image<rgb_pixel> empty;
+	REQUIRE_THROWS_AS(empty.write_to_memory(), error);
+}
+
+TEST_CASE("encoded size estimate tests", "[PNGPP]")
+{
+	// noise does not compress, so the stored size is about what comes out; the Adam7 pass rows add filter bytes
+	for (uint32_t width : {1, 3, 9, 301})
+	{
+		image<rgb_pixel> img(width, 37);
+		uint32_t seed{width};
+		for (uint32_t y{0}; y < img.get_height(); ++y)
+		{
+			for (uint32_t x{0}; x < width; ++x)
+			{
+				seed = seed * 1103515245 + 12345;
+				img[y][x] = rgb_pixel(static_cast<byte>(seed >> 24), static_cast<byte>(seed >> 16), static_cast<byte>(seed >> 8));
+			}
+		}
+
+		image_info info{make_image_info<rgb_pixel>()};
+		info.set_width(width);
+		info.set_height(img.get_height());
+
+		INFO(width);
+		for (interlace_type interlace : {interlace_none, interlace_adam7})
+		{
+			img.set_interlace_type(interlace);
+			info.set_interlace_type(interlace);
+			const auto bytes{img.write_to_memory()};
+			REQUIRE(bytes.size() <= estimate_encoded_size(info));
+			REQUIRE(same_pixels(image<rgb_pixel>(bytes), img));
+		}
+	}
+}
+
+TEST_CASE("memory usage tests", "[PNGPP]")
+{
+	auto img{make_test_image(640, 480)};
+	vector_ostream<> png;
+	const memory_usage usage{img.write_stream(png, encode_options())};
+	REQUIRE(usage.allocations > 0);
+	REQUIRE(usage.peak >= usage.current);
+	// zlib's deflate state alone is over 256K with the defaults
+	REQUIRE(usage.peak > (256 << 10));
+
+	vector_ostream<> small;
+	const memory_usage low{img.write_stream(small, encode_options::low_memory())};
+	REQUIRE(low.peak < usage.peak / 4);
+	REQUIRE(same_pixels(image<rgb_pixel>(small.release()), img));
+
+	vector_ostream<> other;
+	writer<vector_ostream<>> wr(other);
+	REQUIRE(wr.get_memory_usage().allocations > 0);
+	REQUIRE(wr.get_memory_usage().current == wr.get_memory_usage().peak);
+}
+
+/**
+ * \brief The brute force filter_chooser is checked against: filters \a row with every filter and keeps the one with the lowest
+ * filter_cost() in \a out, preceded by its filter type byte.
+ */
+static void filter_row_by_cost(const byte* row, const byte* prev, byte* out, byte* scratch, size_t rowbytes, size_t bpp)
+{
+	out[0] = row_filter_none;
+	::std::memcpy(out + 1, row, rowbytes);
+	uint64_t best{detail::filter_cost(out + 1, rowbytes)};
+
+	for (row_filter filter : {row_filter_sub, row_filter_up, row_filter_avg, row_filter_paeth})
+	{
+		detail::filter_row(filter, row, prev, scratch, rowbytes, bpp);
+		const uint64_t cost{detail::filter_cost(scratch, rowbytes)};
+		if (cost < best)
+		{
+			best = cost;
+			out[0] = static_cast<byte>(filter);
+			::std::memcpy(out + 1, scratch, rowbytes);
+		}
+	}
+}
+
+TEST_CASE("filter chooser tests", "[PNGPP]")
+{
+	uint32_t seed{1};
+	for (auto [type, depth] : {::std::pair{color_type_gray, 8}, {color_type_gray_alpha, 8}, {color_type_rgb, 8}, {color_type_rgba, 8},
+		{color_type_rgb, 16}, {color_type_rgba, 16}})
+	{
+		for (uint32_t width : {1, 5, 13, 47})
+		{
+			image_info info{make_image_info<rgb_pixel>()};
+			info.set_color_type(type);
+			info.set_bit_depth(depth);
+			info.set_width(width);
+			const size_t rowbytes{info.get_rowbytes()};
+			const size_t bpp{get_filter_bpp(info)};
+
+			// smooth rows with noise in the low bits, so the filters come out differently
+			const ::std::vector<byte> zeros(rowbytes);
+			::std::vector<byte> prev(rowbytes);
+			::std::vector<byte> row(rowbytes);
+			::std::vector<byte> expected(rowbytes + 1);
+			::std::vector<byte> scratch(rowbytes);
+			filter_chooser chooser(info, filter_heuristic_min_sad);
+			for (size_t y{0}; y < 8; ++y)
+			{
+				for (size_t i{0}; i < rowbytes; ++i)
+				{
+					seed = seed * 1103515245 + 12345;
+					row[i] = static_cast<byte>(i * y + (seed >> (y < 4 ? 29 : 24)));
+				}
+
+				const byte* above{y == 0 ? zeros.data() : prev.data()};
+				const row_filter chosen{chooser.choose(row.data(), y == 0 ? nullptr : prev.data())};
+				filter_row_by_cost(row.data(), above, expected.data(), scratch.data(), rowbytes, bpp);
+				REQUIRE(chosen == expected[0]);
+				REQUIRE(::std::equal(expected.begin() + 1, expected.end(), chooser.get_filtered(row.data(), chosen)));
+
+				for (row_filter filter : {row_filter_sub, row_filter_up, row_filter_avg, row_filter_paeth})
+				{
+					::std::vector<byte> restored(chooser.get_filtered(row.data(), filter), chooser.get_filtered(row.data(), filter) + rowbytes);
+					detail::unfilter_row(filter, restored.data(), above, rowbytes, bpp);
+					REQUIRE(restored == row);
+				}
+				row.swap(prev);
+			}
+		}
+	}
+
+	// a ramp: None leaves it as is, Sub and Paeth turn it into a constant, which has no entropy
+	image_info info{make_image_info<gray_pixel>()};
+	info.set_width(64);
+	::std::vector<byte> ramp(64);
+	for (size_t i{0}; i < ramp.size(); ++i)
+	{
+		ramp[i] = static_cast<byte>(3 * i);
+	}
+	filter_chooser entropy(info, filter_heuristic_entropy);
+	REQUIRE(entropy.choose(ramp.data(), nullptr) == row_filter_sub);
+
+	// a gain of 100% is never reached, so the first row's filter stays
+	filter_chooser sticky(info, filter_heuristic_sticky, 0, 100);
+	REQUIRE(sticky.choose(ramp.data(), nullptr) == row_filter_sub);
+	REQUIRE(sticky.choose(ramp.data(), ramp.data()) == row_filter_sub);
+	sticky.reset();
+	REQUIRE(sticky.choose(ramp.data(), ramp.data()) == row_filter_up);
+
+	filter_chooser limited(info, filter_heuristic_min_sad, PNG_FILTER_NONE | PNG_FILTER_AVG);
+	REQUIRE(limited.choose(ramp.data(), ramp.data()) == row_filter_avg);
+	REQUIRE(filter_chooser(make_image_info<index_pixel>()).get_filters() == PNG_FILTER_NONE);
+}
+
+TEST_CASE("filter heuristic write tests", "[PNGPP]")
+{
+	auto img{make_test_image(640, 480)};
+	image<rgb_pixel_16> wide(37, 29);
+	for (uint32_t y{0}; y < wide.get_height(); ++y)
+	{
+		for (uint32_t x{0}; x < wide.get_width(); ++x)
+		{
+			wide.set_pixel(x, y, rgb_pixel_16(static_cast<uint16_t>(x * 1000 + y), static_cast<uint16_t>(y * 2000), static_cast<uint16_t>(x * y * 31)));
+		}
+	}
+
+	for (filter_heuristic heuristic : {filter_heuristic_min_sad, filter_heuristic_entropy, filter_heuristic_sticky})
+	{
+		encode_options options;
+		options.heuristic = heuristic;
+		REQUIRE(same_pixels(image<rgb_pixel>(encode(img, options)), img));
+		REQUIRE(same_pixels(image<rgb_pixel_16>(encode(wide, options)), wide));
+
+		options.filters = PNG_FILTER_NONE | PNG_FILTER_SUB;
+		REQUIRE(same_pixels(image<rgb_pixel>(encode(img, options)), img));
+
+		// strips of 5 rows start off the sticky restarts, yet the output does not depend on the threads
+		strip_options strips;
+		strips.strip_rows = 5;
+		strips.heuristic = heuristic;
+		for (bool split : {false, true})
+		{
+			strips.split_points = split;
+			::std::vector<::std::vector<byte>> outputs;
+			for (size_t threads : {1, 3})
+			{
+				strips.thread_count = threads;
+				vector_ostream<> png;
+				img.write_stream_parallel(png, strips);
+				outputs.push_back(png.release());
+			}
+			REQUIRE(outputs[0] == outputs[1]);
+			REQUIRE(same_pixels(image<rgb_pixel>(outputs[0]), img));
+		}
+	}
+}
+
+// the image in a single IDAT chunk, which ends with the Adler-32 and the CRC
+static inline ::std::vector<byte> encode_single_idat(image<rgb_pixel>& img)
+{
+	encode_options options;
+	options.idat_size = 1 << 22;
+	return encode(img, options);
+}
+
+TEST_CASE("decode options tests", "[PNGPP]")
+{
+	auto img{make_test_image(640, 480)};
+	const auto png{encode_single_idat(img)};
+	const auto runs{scan_chunks(png).idat_runs};
+	REQUIRE(runs.size() == 1);
+	const size_t idat_begin{runs[0].begin};
+	const size_t idat_end{runs[0].end};
+
+	// a bad IDAT CRC: libpng rejects a critical chunk with a bad CRC
+	auto bad_crc{png};
+	bad_crc[idat_end - 1] ^= 0xff;
+	REQUIRE_THROWS_AS(image<rgb_pixel>(bad_crc), error);
+	image<rgb_pixel> native;
+	native.read(bad_crc, decode_options::trusted());
+	REQUIRE(same_pixels(native, img));
+
+	image<rgba_pixel> converted;
+	REQUIRE_THROWS_AS(converted.read(bad_crc), error);
+	converted.read(bad_crc, decode_options::trusted());
+	REQUIRE(converted.get_pixel(7, 3).red == img.get_pixel(7, 3).red);
+
+	// a bad Adler-32 under a correct CRC
+	auto bad_adler{png};
+	bad_adler[idat_end - 5] ^= 0xff;
+	const uint32_t crc{static_cast<uint32_t>(::crc32(0, bad_adler.data() + idat_begin + 4, static_cast<uInt>(idat_end - idat_begin - 8)))};
+	store_be32(bad_adler.data() + idat_end - 4, crc);
+	REQUIRE(scan_chunks(bad_adler).is_crc_ok());
+	REQUIRE_THROWS_AS(image<rgb_pixel>(bad_adler), error);
+
+	decode_options adler_only;
+	adler_only.verify_adler = false;
+	native.read(bad_adler, adler_only);
+	REQUIRE(same_pixels(native, img));
+	REQUIRE_THROWS_AS(converted.read(bad_adler), error);
+	converted.read(bad_adler, adler_only);
+	REQUIRE(converted.get_pixel(7, 3).red == img.get_pixel(7, 3).red);
+}
+
+TEST_CASE("validate tests", "[PNGPP]")
+{
+	auto img{make_test_image(640, 480)};
+	const auto png{encode_single_idat(img)};
+	REQUIRE(validate(png));
+	REQUIRE(validate(png).message.empty());
+
+	// 16-bit and interlaced images go through the reader
+	image<rgb_pixel_16> wide(37, 29);
+	REQUIRE(validate(encode(wide, encode_options())));
+	img.set_interlace_type(interlace_adam7);
+	const auto interlaced{encode(img, encode_options())};
+	REQUIRE(validate(interlaced));
+
+	const auto runs{scan_chunks(png).idat_runs};
+	auto bad_crc{png};
+	bad_crc[runs[0].end - 1] ^= 0xff;
+	const auto crc{validate(bad_crc)};
+	REQUIRE_FALSE(crc);
+	REQUIRE(crc.chunk == chunk_type_IDAT);
+	REQUIRE(crc.offset == runs[0].end);
+	REQUIRE(validate(bad_crc, decode_options::trusted()));
+
+	// libpng only warns about a bad CRC on an ancillary chunk
+	chunk_editor editor(png);
+	editor.add_text("Comment", "validate");
+	vector_ostream<> text;
+	editor.write_stream(text);
+	::std::vector<byte> bad_text(text.get_bytes().begin(), text.get_bytes().end());
+	REQUIRE(validate(bad_text));
+	const auto text_index{scan_chunks(bad_text)};
+	const auto text_chunk{::std::ranges::find_if(text_index.chunks, [](const chunk_record& r){ return r.chunk.type == chunk_type_tEXt; })};
+	REQUIRE(text_chunk != text_index.chunks.end());
+	bad_text[text_chunk->chunk.offset + text_chunk->chunk.get_size() - 1] ^= 0x01;
+	const auto ancillary{validate(bad_text)};
+	REQUIRE_FALSE(ancillary);
+	REQUIRE(ancillary.chunk == chunk_type_tEXt);
+	REQUIRE(validate(bad_text, decode_options::trusted()));
+
+	auto bad_data{interlaced};
+	bad_data[bad_data.size() / 2] ^= 0xff;
+	const auto data{validate(bad_data, decode_options::trusted())};
+	REQUIRE_FALSE(data);
+	REQUIRE(data.chunk == chunk_type_IDAT);
+	REQUIRE_FALSE(data.message.empty());
+
+	const auto cut{validate(::std::span(png).first(png.size() / 2))};
+	REQUIRE_FALSE(cut);
+	REQUIRE(cut.chunk == chunk_type_IDAT);
+	REQUIRE(cut.offset == png.size() / 2);
+
+	auto not_png{png};
+	not_png[1] = 'J';
+	const auto signature{validate(not_png)};
+	REQUIRE_FALSE(signature);
+	REQUIRE(signature.chunk == 0);
+}
+
+TEST_CASE("encode options benchmarks", "[PNGPP][.benchmark]")
+{
+	auto img{make_test_image(640, 480)};
+	for (const auto& [name, options] : encode_presets)
+	{
+		vector_ostream<> png;
+		const memory_usage usage{img.write_stream(png, options)};
+		WARN(name << ": " << png.get_bytes().size() << " bytes, " << usage.peak << " bytes peak memory");
+		BENCHMARK(::std::string(name))
+		{
+			return encode(img, options).size();
+		};
+	}
+}
+
+TEST_CASE("filter heuristic benchmarks", "[PNGPP][.benchmark]")
+{
+	auto img{make_test_image(640, 480)};
+	for (auto [name, heuristic] : {::std::pair{"libpng", filter_heuristic_default}, {"min_sad", filter_heuristic_min_sad},
+		{"entropy", filter_heuristic_entropy}, {"sticky", filter_heuristic_sticky}})
+	{
+		encode_options options;
+		options.heuristic = heuristic;
+		WARN(name << ": " << encode(img, options).size() << " bytes");
+		BENCHMARK(name)
+		{
+			return encode(img, options).size();
+		};
+	}
+}
+
+TEST_CASE("decode options benchmarks", "[PNGPP][.benchmark]")
+{
+	auto img{make_test_image(640, 480)};
+	const auto png{encode_single_idat(img)};
+	for (auto [name, options] : {::std::pair{"checked", decode_options()}, {"trusted", decode_options::trusted()}})
+	{
+		BENCHMARK(::std::string("native, ") + name)
+		{
+			image<rgb_pixel> decoded;
+			decoded.read(png, options);
+			return decoded.get_width();
+		};
+		BENCHMARK(::std::string("libpng, ") + name)
+		{
+			image<rgba_pixel> decoded;
+			decoded.read(png, options);
+			return decoded.get_width();
+		};
+		BENCHMARK(::std::string("validate, ") + name)
+		{
+			return validate(png, options).ok;
+		};
+	}
+}
+
+TEST_CASE("chunk editor benchmarks", "[PNGPP][.benchmark]")
+{
+	auto img{make_test_image(640, 480)};
+	const auto png{encode(img, encode_options())};
+	BENCHMARK("chunk_editor")
+	{
+		chunk_editor editor(png);
+		editor.set_text("Copyright", "png++");
+		vector_ostream<> out;
+		editor.write_stream(out);
+		return out.get_bytes().size();
+	};
+	BENCHMARK("read and write")
+	{
+		image<rgb_pixel> decoded(png);
+		return encode(decoded, encode_options()).size();
+	};
+}
+
+} // namespace png::testing